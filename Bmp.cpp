@@ -0,0 +1,435 @@
+#include "Bmp.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "Parallel.h"
+#include "PixelFormat.h"
+
+namespace {
+    constexpr size_t FILE_HEADER_SIZE = 14;
+    // OS/2 BITMAPCOREHEADER: 16-bit dimensions and 3-byte palette entries.
+    constexpr std::uint32_t CORE_HEADER_SIZE = 12;
+    constexpr int BI_RGB = 0;
+    constexpr int BI_RLE8 = 1;
+    constexpr int BI_RLE4 = 2;
+    constexpr int BI_BITFIELDS = 3;
+    constexpr int BI_ALPHABITFIELDS = 6;
+
+    // Bytes of pixel rows read from or written to disk at once; each strip
+    // is converted by all workers while it is hot in cache.
+    constexpr size_t READ_STRIP_BYTES = 4 << 20;
+
+    // Rows converted per task.
+    constexpr int MIN_ROWS_PER_TASK = 16;
+
+    std::uint32_t readU32(const std::uint8_t* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+    }
+
+    std::uint16_t readU16(const std::uint8_t* p) {
+        return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    void writeU32(std::uint8_t* p, std::uint32_t value) {
+        p[0] = static_cast<std::uint8_t>(value);
+        p[1] = static_cast<std::uint8_t>(value >> 8);
+        p[2] = static_cast<std::uint8_t>(value >> 16);
+        p[3] = static_cast<std::uint8_t>(value >> 24);
+    }
+
+    void writeU16(std::uint8_t* p, std::uint16_t value) {
+        p[0] = static_cast<std::uint8_t>(value);
+        p[1] = static_cast<std::uint8_t>(value >> 8);
+    }
+}
+
+fileManagement::BmpReader::BmpReader(const std::filesystem::path& path) : file(path, std::ios::binary) {
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+
+    std::uint8_t header[FILE_HEADER_SIZE + 4];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != 'B' || header[1] != 'M') {
+        throw std::invalid_argument("Not a BMP file");
+    }
+
+    pixelOffset = readU32(header + 10);
+    std::uint32_t infoSize = readU32(header + 14);
+    if (infoSize != CORE_HEADER_SIZE && (infoSize < 40 || infoSize > 1024)) {
+        throw std::invalid_argument("Unsupported BMP header");
+    }
+
+    // Info header plus the three or four masks that may follow a plain
+    // BITMAPINFOHEADER.
+    std::vector<std::uint8_t> info(std::max<size_t>(infoSize, 56));
+    std::memcpy(info.data(), header + FILE_HEADER_SIZE, 4);
+    if (!file.read(reinterpret_cast<char*>(info.data()) + 4, info.size() - 4) && infoSize > 40) {
+        throw std::invalid_argument("Truncated BMP header");
+    }
+
+    std::int32_t width;
+    std::int32_t height;
+    std::uint32_t compression = BI_RGB;
+    std::uint32_t colorsUsed = 0;
+    size_t paletteEntrySize = 4;
+    if (infoSize == CORE_HEADER_SIZE) {
+        width = readU16(info.data() + 4);
+        height = readU16(info.data() + 6);
+        bits = readU16(info.data() + 10);
+        paletteEntrySize = 3;
+    } else {
+        width = static_cast<std::int32_t>(readU32(info.data() + 4));
+        height = static_cast<std::int32_t>(readU32(info.data() + 8));
+        bits = readU16(info.data() + 14);
+        compression = readU32(info.data() + 16);
+        colorsUsed = readU32(info.data() + 32);
+    }
+
+    if (width <= 0 || height == 0 || height == INT32_MIN || width > 0xFFFFFF || std::abs(height) > 0xFFFFFF) {
+        throw std::invalid_argument("Invalid BMP dimensions");
+    }
+    imageWidth = width;
+    imageHeight = std::abs(height);
+    topDown = height < 0;
+    stride = (static_cast<size_t>(imageWidth) * bits + 31) / 32 * 4;
+
+    size_t paletteOffset = FILE_HEADER_SIZE + infoSize;
+    bool bitfields = compression == BI_BITFIELDS || compression == BI_ALPHABITFIELDS;
+    if (bitfields && (bits == 16 || bits == 32)) {
+        bool alphaMask = compression == BI_ALPHABITFIELDS || infoSize >= 56;
+        masks[0] = ChannelMask::from(readU32(info.data() + 40));
+        masks[1] = ChannelMask::from(readU32(info.data() + 44));
+        masks[2] = ChannelMask::from(readU32(info.data() + 48));
+        masks[3] = ChannelMask::from(alphaMask ? readU32(info.data() + 52) : 0);
+        if (infoSize == 40) {
+            paletteOffset += compression == BI_ALPHABITFIELDS ? 16 : 12;
+        }
+    } else if (compression == BI_RGB && (bits == 16 || bits == 32)) {
+        // 16-bit pixels default to 5-5-5, 32-bit ones to B, G, R, unused.
+        std::uint32_t red = bits == 16 ? 0x7C00 : 0xFF0000;
+        std::uint32_t green = bits == 16 ? 0x03E0 : 0x00FF00;
+        std::uint32_t blue = bits == 16 ? 0x001F : 0x0000FF;
+        masks = {ChannelMask::from(red), ChannelMask::from(green), ChannelMask::from(blue), ChannelMask{}};
+    } else if ((compression == BI_RLE8 && bits == 8) || (compression == BI_RLE4 && bits == 4)) {
+        rle = true;
+    } else if (compression != BI_RGB || (bits != 1 && bits != 4 && bits != 8 && bits != 24)) {
+        throw std::invalid_argument("Unsupported BMP format");
+    }
+
+    if (bits <= 8) {
+        size_t colors = colorsUsed != 0 ? std::min<size_t>(colorsUsed, 256) : size_t{1} << bits;
+        std::vector<std::uint8_t> entries(colors * paletteEntrySize);
+        file.clear();
+        file.seekg(paletteOffset);
+        if (!file.read(reinterpret_cast<char*>(entries.data()), entries.size())) {
+            throw std::invalid_argument("Truncated BMP palette");
+        }
+
+        // Stored as B, G, R (and a reserved byte); always opaque.
+        for (size_t i = 0; i < colors; i++) {
+            const std::uint8_t* entry = entries.data() + i * paletteEntrySize;
+            palette[i] = entry[2] | (entry[1] << 8) | (entry[0] << 16) | 0xFF000000u;
+        }
+    }
+}
+
+fileManagement::BmpReader::ChannelMask fileManagement::BmpReader::ChannelMask::from(std::uint32_t mask) {
+    if (mask == 0) {
+        return {};
+    }
+
+    int shift = std::countr_zero(mask);
+    int count = std::popcount(mask);
+    if (count < 32 && (mask >> shift) != (1u << count) - 1) {
+        throw std::invalid_argument("Unsupported BMP channel masks");
+    }
+    return {mask, shift, count};
+}
+
+std::uint8_t fileManagement::BmpReader::ChannelMask::extract(std::uint32_t pixel) const {
+    if (mask == 0) {
+        return 0xFF;
+    }
+
+    // Wider channels keep their top 8 bits, narrower ones are scaled so
+    // their maximum becomes 255.
+    std::uint32_t value = (pixel & mask) >> shift;
+    if (bits >= 8) {
+        return static_cast<std::uint8_t>(value >> (bits - 8));
+    }
+    return static_cast<std::uint8_t>(value * 255 / ((1u << bits) - 1));
+}
+
+void fileManagement::BmpReader::convertRow(const std::uint8_t* row, std::byte* rgba) const {
+    std::uint8_t* out = reinterpret_cast<std::uint8_t*>(rgba);
+
+    switch (bits) {
+    case 24:
+        PixelFormat::BGR24ToRGBA32(row, out, imageWidth);
+        break;
+    case 16:
+        for (int x = 0; x < imageWidth; x++, row += 2, out += 4) {
+            std::uint32_t pixel = readU16(row);
+            for (int c = 0; c < 4; c++) {
+                out[c] = masks[c].extract(pixel);
+            }
+        }
+        break;
+    case 32:
+        if (masks[0].mask == 0xFF0000 && masks[1].mask == 0xFF00 && masks[2].mask == 0xFF
+            && (masks[3].mask == 0xFF000000u || masks[3].mask == 0)) {
+            PixelFormat::BGRA32ToRGBA32(row, out, imageWidth, masks[3].mask == 0);
+            break;
+        }
+        for (int x = 0; x < imageWidth; x++, row += 4, out += 4) {
+            std::uint32_t pixel = readU32(row);
+            for (int c = 0; c < 4; c++) {
+                out[c] = masks[c].extract(pixel);
+            }
+        }
+        break;
+    case 8:
+        PixelFormat::Indexed8ToRGBA32(row, palette.data(), out, imageWidth);
+        break;
+    default: {
+        // 1 and 4-bit indices, most significant bits first.
+        int perByte = 8 / bits;
+        int mask = (1 << bits) - 1;
+        for (int x = 0; x < imageWidth; x++, out += 4) {
+            int shift = (perByte - 1 - x % perByte) * bits;
+            std::uint32_t color = palette[(row[x / perByte] >> shift) & mask];
+            std::memcpy(out, &color, 4);
+        }
+        break;
+    }
+    }
+}
+
+void fileManagement::BmpReader::decodeRle() {
+    file.clear();
+    file.seekg(0, std::ios::end);
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    if (pixelOffset > fileSize) {
+        throw std::invalid_argument("Truncated BMP pixel data");
+    }
+
+    std::vector<std::uint8_t> data(fileSize - pixelOffset);
+    file.seekg(pixelOffset);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        throw std::invalid_argument("Truncated BMP pixel data");
+    }
+
+    // Pixels the runs skip (deltas, early ends of lines) stay at index 0.
+    rleIndices.assign(static_cast<size_t>(imageWidth) * imageHeight, 0);
+    std::int64_t x = 0;
+    std::int64_t y = 0;
+    auto put = [&](std::uint8_t index) {
+        if (x < imageWidth && y < imageHeight) {
+            std::int64_t row = topDown ? y : imageHeight - 1 - y;
+            rleIndices[static_cast<size_t>(row) * imageWidth + x] = index;
+        }
+        x++;
+    };
+    // Nibble i of a RLE4 byte pair run, high nibble first.
+    auto nibble = [](std::uint8_t byte, int i) {
+        return static_cast<std::uint8_t>(i % 2 == 0 ? byte >> 4 : byte & 0x0F);
+    };
+
+    const std::uint8_t* p = data.data();
+    const std::uint8_t* end = p + data.size();
+    while (end - p >= 2 && y < imageHeight) {
+        int count = p[0];
+        int value = p[1];
+        p += 2;
+
+        if (count > 0) {
+            for (int i = 0; i < count; i++) {
+                put(bits == 8 ? value : nibble(value, i));
+            }
+        } else if (value == 0) {
+            x = 0;
+            y++;
+        } else if (value == 1) {
+            break;
+        } else if (value == 2) {
+            if (end - p < 2) {
+                break;
+            }
+            x += p[0];
+            y += p[1];
+            p += 2;
+        } else {
+            // value literal pixels, padded to a 16-bit boundary.
+            std::ptrdiff_t bytes = bits == 8 ? value : (value + 1) / 2;
+            if (end - p < bytes) {
+                break;
+            }
+            for (int i = 0; i < value; i++) {
+                put(bits == 8 ? p[i] : nibble(p[i / 2], i));
+            }
+            p += std::min(bytes + (bytes & 1), end - p);
+        }
+    }
+}
+
+void fileManagement::BmpReader::readRows(int firstRow, int rowCount, std::byte* rgba) {
+    size_t rowBytes = static_cast<size_t>(imageWidth) * 4;
+
+    if (rle) {
+        if (rleIndices.empty()) {
+            decodeRle();
+        }
+
+        Parallel::For(rowCount, MIN_ROWS_PER_TASK, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const std::uint8_t* indices = rleIndices.data() + static_cast<size_t>(firstRow + i) * imageWidth;
+                PixelFormat::Indexed8ToRGBA32(indices, palette.data(), reinterpret_cast<std::uint8_t*>(rgba + i * rowBytes), imageWidth);
+            }
+        });
+        return;
+    }
+
+    // Bottom-up files store the strip's rows last row first, still contiguous.
+    int firstStored = topDown ? firstRow : imageHeight - firstRow - rowCount;
+    rowBuffer.resize(stride * rowCount);
+
+    file.clear();
+    file.seekg(pixelOffset + firstStored * stride);
+    if (!file.read(reinterpret_cast<char*>(rowBuffer.data()), rowBuffer.size())) {
+        throw std::invalid_argument("Truncated BMP pixel data");
+    }
+
+    Parallel::For(rowCount, MIN_ROWS_PER_TASK, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            int stored = topDown ? i : rowCount - 1 - i;
+            convertRow(rowBuffer.data() + stored * stride, rgba + i * rowBytes);
+        }
+    });
+}
+
+void fileManagement::BmpReader::read(std::span<std::byte> rgba) {
+    size_t rowBytes = static_cast<size_t>(imageWidth) * 4;
+    if (rgba.size() < rowBytes * imageHeight) {
+        throw std::invalid_argument("BMP output buffer too small");
+    }
+
+    int stripRows = static_cast<int>(std::max<size_t>(1, READ_STRIP_BYTES / stride));
+    for (int y = 0; y < imageHeight; y += stripRows) {
+        int rows = std::min(stripRows, imageHeight - y);
+        readRows(y, rows, rgba.data() + y * rowBytes);
+    }
+}
+
+void fileManagement::BmpReader::readStrips(int stripRows, const StripCallback& callback) {
+    if (stripRows <= 0) {
+        throw std::invalid_argument("Invalid BMP strip height");
+    }
+
+    size_t rowBytes = static_cast<size_t>(imageWidth) * 4;
+    std::vector<std::byte> strip(rowBytes * std::min(stripRows, imageHeight));
+
+    for (int y = 0; y < imageHeight; y += stripRows) {
+        int rows = std::min(stripRows, imageHeight - y);
+        readRows(y, rows, strip.data());
+        callback(y, rows, std::span<const std::byte>(strip.data(), rows * rowBytes));
+    }
+}
+
+void fileManagement::saveBMP(const IndexedImage& image, const std::filesystem::path& path) {
+    if (image.width <= 0 || image.height <= 0
+        || image.indices.size() != static_cast<size_t>(image.width) * image.height) {
+        throw std::invalid_argument("Invalid image");
+    }
+    if (image.palette.empty() || image.palette.size() > 256) {
+        throw std::invalid_argument("BMP palettes hold 1 to 256 colours");
+    }
+
+    bool nibbles = image.palette.size() <= 16
+        && std::all_of(image.indices.begin(), image.indices.end(), [](std::uint8_t index) { return index < 16; });
+    int bits = nibbles ? 4 : 8;
+    size_t stride = (static_cast<size_t>(image.width) * bits + 31) / 32 * 4;
+    size_t colors = image.palette.size();
+    size_t pixelOffset = FILE_HEADER_SIZE + 40 + colors * 4;
+    size_t fileSize = pixelOffset + stride * image.height;
+    if (fileSize > 0xFFFFFFFFu) {
+        throw std::invalid_argument("Image too large for a BMP file");
+    }
+
+    std::vector<std::uint8_t> header(pixelOffset, 0);
+    std::uint8_t* p = header.data();
+    p[0] = 'B';
+    p[1] = 'M';
+    writeU32(p + 2, static_cast<std::uint32_t>(fileSize));
+    writeU32(p + 10, static_cast<std::uint32_t>(pixelOffset));
+
+    // BITMAPINFOHEADER, bottom-up, uncompressed.
+    p += FILE_HEADER_SIZE;
+    writeU32(p, 40);
+    writeU32(p + 4, static_cast<std::uint32_t>(image.width));
+    writeU32(p + 8, static_cast<std::uint32_t>(image.height));
+    writeU16(p + 12, 1);
+    writeU16(p + 14, static_cast<std::uint16_t>(bits));
+    writeU32(p + 16, BI_RGB);
+    writeU32(p + 20, static_cast<std::uint32_t>(stride * image.height));
+    writeU32(p + 24, 2835);
+    writeU32(p + 28, 2835);
+    writeU32(p + 32, static_cast<std::uint32_t>(colors));
+    writeU32(p + 36, static_cast<std::uint32_t>(colors));
+
+    // Palette entries as B, G, R, reserved.
+    p += 40;
+    for (std::uint32_t color: image.palette) {
+        *p++ = (color >> 16) & 0xFF;
+        *p++ = (color >> 8) & 0xFF;
+        *p++ = color & 0xFF;
+        *p++ = 0;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    // File rows go bottom-up: strip row i holds image row y0 - i.
+    int stripRows = static_cast<int>(std::max<size_t>(1, READ_STRIP_BYTES / stride));
+    std::vector<std::uint8_t> strip(stride * std::min(stripRows, image.height));
+
+    for (int written = 0; written < image.height; written += stripRows) {
+        int rows = std::min(stripRows, image.height - written);
+        int y0 = image.height - 1 - written;
+
+        Parallel::For(rows, MIN_ROWS_PER_TASK, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const std::uint8_t* source = image.indices.data() + static_cast<size_t>(y0 - i) * image.width;
+                std::uint8_t* row = strip.data() + i * stride;
+
+                if (nibbles) {
+                    int x = 0;
+                    for (; x + 1 < image.width; x += 2) {
+                        *row++ = static_cast<std::uint8_t>((source[x] << 4) | source[x + 1]);
+                    }
+                    if (x < image.width) {
+                        *row++ = static_cast<std::uint8_t>(source[x] << 4);
+                    }
+                } else {
+                    std::memcpy(row, source, image.width);
+                    row += image.width;
+                }
+                std::memset(row, 0, strip.data() + (i + 1) * stride - row);
+            }
+        });
+
+        file.write(reinterpret_cast<const char*>(strip.data()), rows * stride);
+    }
+
+    if (!file) {
+        throw std::invalid_argument("Can't write file");
+    }
+    file.close();
+}
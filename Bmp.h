@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "IndexedImage.h"
+
+namespace fileManagement {
+    // Streaming BMP decoder for uncompressed 1, 4, 8, 16, 24 and 32-bit
+    // files (BI_RGB or BI_BITFIELDS with any contiguous channel masks),
+    // RLE4/RLE8 compressed files and OS/2 core headers, stored bottom-up or
+    // top-down. Only the header and palette are read up front; pixel rows
+    // are read in strips and converted to RGBA (R in the first byte) top row
+    // first, so memory beyond the caller's buffer stays proportional to the
+    // strip height. RLE data can't be read by row, so it is expanded to one
+    // index per pixel on the first read.
+    class BmpReader {
+    public:
+        explicit BmpReader(const std::filesystem::path& path);
+
+        int width() const { return imageWidth; }
+        int height() const { return imageHeight; }
+        int bitsPerPixel() const { return bits; }
+
+        // Decodes every row into rgba, width * height * 4 bytes.
+        void read(std::span<std::byte> rgba);
+
+        // Hands out the image in strips of up to stripRows rows from the top:
+        // callback(firstRow, rowCount, rgba of rowCount rows). The strip
+        // buffer is reused, so consumers must copy what they keep.
+        using StripCallback = std::function<void(int firstRow, int rowCount, std::span<const std::byte> rgba)>;
+        void readStrips(int stripRows, const StripCallback& callback);
+
+    private:
+        // Where a channel sits in a 16 or 32-bit pixel. A zero mask reads as
+        // 255 (no alpha channel).
+        struct ChannelMask {
+            std::uint32_t mask = 0;
+            int shift = 0;
+            int bits = 0;
+
+            // Throws std::invalid_argument for masks with gaps.
+            static ChannelMask from(std::uint32_t mask);
+            std::uint8_t extract(std::uint32_t pixel) const;
+        };
+
+        // Reads and converts rows [firstRow, firstRow + rowCount) into rgba.
+        void readRows(int firstRow, int rowCount, std::byte* rgba);
+        void convertRow(const std::uint8_t* row, std::byte* rgba) const;
+        // Expands the RLE payload into rleIndices.
+        void decodeRle();
+
+        std::ifstream file;
+        int imageWidth = 0;
+        int imageHeight = 0;
+        int bits = 0;
+        bool topDown = false;
+        size_t pixelOffset = 0;
+        size_t stride = 0;
+        // Red, green, blue and alpha masks.
+        std::array<ChannelMask, 4> masks = {};
+        // BI_RLE8 or BI_RLE4 payload; rleIndices holds the expanded image,
+        // top row first, once it has been read.
+        bool rle = false;
+        std::vector<std::uint8_t> rleIndices;
+        std::array<std::uint32_t, 256> palette = {};
+        std::vector<std::uint8_t> rowBuffer;
+    };
+
+    // Writes the palette and indices as a paletted BMP: 4 bits per pixel when
+    // every index fits in 16 colours, 8 otherwise. Rows are packed in large
+    // strips, in parallel, and each strip is written with one call.
+    void saveBMP(const IndexedImage& image, const std::filesystem::path& path);
+}
@@ -0,0 +1,104 @@
+#include "CompactImage.h"
+
+#include <stdexcept>
+
+void CompactImage::Reset(int newWidth, int newHeight)
+{
+  if (newWidth < 0 || newHeight < 0) {
+    throw std::invalid_argument("Invalid image size");
+  }
+
+  width = newWidth;
+  height = newHeight;
+  rows = 0;
+  storage = PixelStorage::Luma8;
+  // Room for Rgb24 is reserved up front so widening never reallocates.
+  // A grey image only touches the first third of it.
+  pixels.Reserve(PixelCount() * 3);
+  pixels.Resize(PixelCount());
+}
+
+void CompactImage::AppendRows(const uint32_t* rgba, int rowCount)
+{
+  if (rowCount < 0 || rowCount > height - rows) {
+    throw std::invalid_argument("More rows than the image has");
+  }
+
+  for (int i = 0; i < rowCount; ++i, ++rows) {
+    const uint32_t* source = rgba + static_cast<size_t>(i) * width;
+
+    if (storage == PixelStorage::Luma8) {
+      uint32_t colour = 0;
+      for (int j = 0; j < width; ++j) {
+        uint32_t r = source[j] & 0xFF;
+        colour |= ((source[j] >> 8) & 0xFF) ^ r;
+        colour |= ((source[j] >> 16) & 0xFF) ^ r;
+      }
+
+      if (colour != 0) {
+        Widen();
+      }
+    }
+
+    uint8_t* destination = reinterpret_cast<uint8_t*>(pixels.data())
+      + static_cast<size_t>(rows) * width * BytesPerPixel();
+
+    if (storage == PixelStorage::Luma8) {
+      for (int j = 0; j < width; ++j) {
+        destination[j] = static_cast<uint8_t>(source[j]);
+      }
+    } else {
+      for (int j = 0; j < width; ++j) {
+        destination[j * 3 + 0] = static_cast<uint8_t>(source[j]);
+        destination[j * 3 + 1] = static_cast<uint8_t>(source[j] >> 8);
+        destination[j * 3 + 2] = static_cast<uint8_t>(source[j] >> 16);
+      }
+    }
+  }
+}
+
+void CompactImage::Assign(const ImageView& image)
+{
+  Reset(image.width, image.height);
+
+  for (int i = 0; i < image.height; ++i) {
+    AppendRows(image.Row(i), 1);
+  }
+}
+
+CompactImage::Channels CompactImage::RowChannels(int y, std::vector<uint8_t>& scratch) const
+{
+  const uint8_t* row = Row(y);
+
+  if (storage == PixelStorage::Luma8) {
+    return {row, row, row};
+  }
+
+  scratch.resize(static_cast<size_t>(width) * 3);
+  uint8_t* r = scratch.data();
+  uint8_t* g = r + width;
+  uint8_t* b = g + width;
+
+  for (int j = 0; j < width; ++j) {
+    r[j] = row[j * 3 + 0];
+    g[j] = row[j * 3 + 1];
+    b[j] = row[j * 3 + 2];
+  }
+
+  return {r, g, b};
+}
+
+void CompactImage::Widen()
+{
+  // Reset reserved 3 bytes per pixel, so this keeps the grey rows. They
+  // are expanded from the last pixel back: pixel i moves to 3 * i, which
+  // never overwrites a grey pixel that is still to be read.
+  pixels.Resize(PixelCount() * 3);
+  uint8_t* data = reinterpret_cast<uint8_t*>(pixels.data());
+
+  for (size_t i = static_cast<size_t>(rows) * width; i-- > 0;) {
+    data[i * 3 + 0] = data[i * 3 + 1] = data[i * 3 + 2] = data[i];
+  }
+
+  storage = PixelStorage::Rgb24;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ImageBuffer.h"
+#include "ImageView.h"
+
+// How a CompactImage stores its pixels.
+enum class PixelStorage
+{
+  Rgb24, // R, G, B bytes per pixel
+  Luma8  // one byte per pixel, for images whose pixels are all grey
+};
+
+// Loaded original kept in the narrowest form the pipeline can work from.
+// The palette, quantization and dithering code never look at alpha, so it
+// is dropped, and an image whose pixels all have R == G == B keeps a single
+// byte per pixel. Both are lossless for every kernel result. Rows are
+// appended as they are decoded: storage starts as Luma8 and widens to Rgb24
+// at the first colour pixel, so the full RGBA image never has to exist.
+class CompactImage
+{
+public:
+  // Pointers to the R, G and B bytes of one row. For Luma8 all three point
+  // at the same plane.
+  struct Channels
+  {
+    const std::uint8_t* r;
+    const std::uint8_t* g;
+    const std::uint8_t* b;
+  };
+
+  // Starts an empty width x height image. The buffer of a previous image
+  // is kept when it can hold the new one as Rgb24.
+  void Reset(int width, int height);
+
+  // Appends rowCount tightly packed RGBA rows below the rows so far.
+  void AppendRows(const std::uint32_t* rgba, int rowCount);
+
+  // Reset and AppendRows for a whole view.
+  void Assign(const ImageView& image);
+
+  int Width() const { return width; }
+  int Height() const { return height; }
+  PixelStorage Storage() const { return storage; }
+  int BytesPerPixel() const { return storage == PixelStorage::Luma8 ? 1 : 3; }
+  std::size_t PixelCount() const { return static_cast<std::size_t>(width) * height; }
+  bool empty() const { return PixelCount() == 0 || rows < height; }
+
+  const std::uint8_t* Row(int y) const
+  {
+    return reinterpret_cast<const std::uint8_t*>(pixels.data())
+      + static_cast<std::size_t>(y) * width * BytesPerPixel();
+  }
+
+  // Channel rows of row y; Rgb24 rows are split into scratch.
+  Channels RowChannels(int y, std::vector<std::uint8_t>& scratch) const;
+
+  // R, G, B and opaque alpha of one pixel.
+  std::array<std::uint8_t, 4> Pixel(int y, int x) const
+  {
+    const std::uint8_t* p = Row(y) + static_cast<std::size_t>(x) * BytesPerPixel();
+    return storage == PixelStorage::Luma8
+      ? std::array<std::uint8_t, 4>{p[0], p[0], p[0], 255}
+      : std::array<std::uint8_t, 4>{p[0], p[1], p[2], 255};
+  }
+
+private:
+  // Converts the rows so far from Luma8 to Rgb24.
+  void Widen();
+
+  ImageBuffer pixels;
+  int width = 0;
+  int height = 0;
+  int rows = 0;
+  PixelStorage storage = PixelStorage::Luma8;
+};
@@ -0,0 +1,178 @@
+#include "DG5Analysis.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "DG5Blocks.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+namespace {
+    // Complete v1 payload, either block layout.
+    struct PackedPayload {
+        Header header;
+        BlockRegion region;
+        BlockLayout layout;
+        const Uint8* blocks;
+
+        explicit PackedPayload(std::span<const std::byte> data) {
+            header = parseHeader(data);
+            if (header.version != 1) {
+                throw std::invalid_argument("Packed analysis needs a v1 DG5 file");
+            }
+
+            region = {0, 0, header.width, header.height};
+            layout = header.planar() ? BlockLayout::planar(region.blockCount()) : BlockLayout::interleaved();
+            blocks = reinterpret_cast<const Uint8*>(data.data()) + HEADER_SIZE + PALETTE_SIZE;
+            if (data.size() < HEADER_SIZE + PALETTE_SIZE + region.blockCount() * BYTES_PER_BLOCK) {
+                throw std::invalid_argument("Truncated DG5 payload");
+            }
+        }
+
+        // Bits of the pixels of column strip col that lie inside the image.
+        Uint8 columnMask(int col) const {
+            int count = std::min(PIXELS_PER_BLOCK, region.width - col * PIXELS_PER_BLOCK);
+            return static_cast<Uint8>((1u << count) - 1);
+        }
+    };
+}
+
+fileManagement::DiffStats fileManagement::diff(std::span<const std::byte> a, std::span<const std::byte> b) {
+    PackedPayload first(a);
+    PackedPayload second(b);
+
+    if (first.region.width != second.region.width || first.region.height != second.region.height) {
+        throw std::invalid_argument("Images differ in size");
+    }
+
+    const BlockRegion& region = first.region;
+    int columns = region.columns();
+    std::vector<DiffStats> columnStats(columns);
+
+    Parallel::For(columns, minColumnsPerTask(region.height), [&](int begin, int end) {
+        for (int col = begin; col < end; col++) {
+            DiffStats& stats = columnStats[col];
+            Uint8 valid = first.columnMask(col);
+            Uint8 columnBits = 0;
+            int firstRow = -1;
+            int lastRow = -1;
+
+            for (int row = 0; row < region.height; row++) {
+                size_t block = region.blockIndex(col, row);
+                Uint8 x[BYTES_PER_BLOCK];
+                Uint8 y[BYTES_PER_BLOCK];
+                first.layout.load(first.blocks, block, 0x1F, x);
+                second.layout.load(second.blocks, block, 0x1F, y);
+
+                Uint8 changed = ((x[0] ^ y[0]) | (x[1] ^ y[1]) | (x[2] ^ y[2]) | (x[3] ^ y[3]) | (x[4] ^ y[4])) & valid;
+                if (changed == 0) continue;
+
+                stats.differingPixels += std::popcount(changed);
+                columnBits |= changed;
+                if (firstRow < 0) firstRow = row;
+                lastRow = row;
+            }
+
+            if (columnBits != 0) {
+                stats.x = col * PIXELS_PER_BLOCK + std::countr_zero(columnBits);
+                stats.width = col * PIXELS_PER_BLOCK + std::bit_width(columnBits) - stats.x;
+                stats.y = firstRow;
+                stats.height = lastRow + 1 - firstRow;
+            }
+        }
+    });
+
+    DiffStats total;
+    int x1 = 0;
+    int y1 = 0;
+    for (const DiffStats& stats: columnStats) {
+        if (stats.differingPixels == 0) continue;
+
+        if (total.differingPixels == 0) {
+            total.x = stats.x;
+            total.y = stats.y;
+            x1 = stats.x + stats.width;
+            y1 = stats.y + stats.height;
+        } else {
+            total.x = std::min(total.x, stats.x);
+            total.y = std::min(total.y, stats.y);
+            x1 = std::max(x1, stats.x + stats.width);
+            y1 = std::max(y1, stats.y + stats.height);
+        }
+        total.differingPixels += stats.differingPixels;
+    }
+    if (total.differingPixels != 0) {
+        total.width = x1 - total.x;
+        total.height = y1 - total.y;
+    }
+
+    return total;
+}
+
+std::array<std::uint64_t, 32> fileManagement::histogram(std::span<const std::byte> data) {
+    PackedPayload image(data);
+    const BlockRegion& region = image.region;
+    int columns = region.columns();
+    std::vector<std::array<std::uint64_t, 32>> partial(columns);
+
+    Parallel::For(columns, minColumnsPerTask(region.height), [&](int begin, int end) {
+        for (int col = begin; col < end; col++) {
+            auto& counts = partial[col];
+            counts.fill(0);
+            Uint8 valid = image.columnMask(col);
+
+            for (int row = 0; row < region.height; row++) {
+                Uint8 planes[BYTES_PER_BLOCK];
+                image.layout.load(image.blocks, region.blockIndex(col, row), 0x1F, planes);
+
+                // Split the pixels by plane 4, then each half by plane 3 and
+                // so on; the 32 leaves select the pixels of every code.
+                Uint8 masks[32];
+                masks[0] = valid;
+                int count = 1;
+                for (int b = PLANE_COUNT - 1; b >= 0; b--) {
+                    for (int i = count - 1; i >= 0; i--) {
+                        masks[2 * i + 1] = masks[i] & planes[b];
+                        masks[2 * i] = masks[i] & ~planes[b];
+                    }
+                    count *= 2;
+                }
+
+                for (int code = 0; code < 32; code++) {
+                    counts[code] += std::popcount(masks[code]);
+                }
+            }
+        }
+    });
+
+    std::array<std::uint64_t, 32> total{};
+    for (const auto& counts: partial) {
+        for (int code = 0; code < 32; code++) {
+            total[code] += counts[code];
+        }
+    }
+    return total;
+}
+
+bool fileManagement::equal(std::span<const std::byte> a, std::span<const std::byte> b) {
+    PackedPayload first(a);
+    PackedPayload second(b);
+
+    if (first.region.width != second.region.width || first.region.height != second.region.height
+        || (first.header.modeByte & ~FLAG_PLANAR) != (second.header.modeByte & ~FLAG_PLANAR)
+        || first.header.dithering != second.header.dithering
+        || std::memcmp(a.data() + HEADER_SIZE, b.data() + HEADER_SIZE, PALETTE_SIZE) != 0) {
+        return false;
+    }
+
+    // The same layout compares byte for byte, padding bits included.
+    if (first.header.planar() == second.header.planar()
+        && std::memcmp(first.blocks, second.blocks, first.region.blockCount() * BYTES_PER_BLOCK) == 0) {
+        return true;
+    }
+    return diff(a, b).differingPixels == 0;
+}
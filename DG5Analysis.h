@@ -0,0 +1,34 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace fileManagement {
+    // Comparisons and statistics computed on the packed blocks of v1 DG5
+    // data (interleaved or plane-ordered) without expanding pixels. XOR-ing
+    // two blocks leaves a set bit in some plane for every pixel whose code
+    // differs, so OR-ing the planes and counting bits gives the differences
+    // of 8 pixels at once.
+
+    // Pixels whose codes differ and their bounding box [x, x + width) x
+    // [y, y + height), empty when the payloads match. Codes are compared,
+    // not colours: use equal() to check the palettes as well.
+    struct DiffStats {
+        std::uint64_t differingPixels = 0;
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Both images must have the same size.
+    DiffStats diff(std::span<const std::byte> a, std::span<const std::byte> b);
+
+    // Number of pixels using every code (palette index for indexed files).
+    std::array<std::uint64_t, 32> histogram(std::span<const std::byte> data);
+
+    // True when size, mode, dithering, palette and every pixel code match;
+    // the block layout may differ.
+    bool equal(std::span<const std::byte> a, std::span<const std::byte> b);
+}
@@ -0,0 +1,326 @@
+#pragma once
+// Building blocks shared by the DG5 readers and writers. Not part of the
+// public fileManagement API.
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+
+#include "SDL3/SDL_stdinc.h"
+
+namespace fileManagement::detail {
+    inline constexpr int PIXELS_PER_BLOCK = 8;
+    inline constexpr int BYTES_PER_BLOCK = 5;
+    inline constexpr int PLANE_COUNT = 5;
+    inline constexpr int HEADER_SIZE = 12;
+    inline constexpr int PALETTE_COLORS = 32;
+    inline constexpr int PALETTE_SIZE = PALETTE_COLORS * 3;
+
+    // Set in the mode byte when the codes are indices into the stored palette
+    // (stored as R, G, B). Without it the codes are fixed RGB 2-2-1 values.
+    inline constexpr int FLAG_INDEXED = 0x80;
+
+    // Set in the mode byte when the payload is plane-ordered: the bit-4 byte
+    // of every block first, then bit 3 and so on, each plane a contiguous
+    // region in the usual column-major block order. The top planes of a
+    // partially read file are enough for a preview.
+    inline constexpr int FLAG_PLANAR = 0x40;
+    inline constexpr int MODE_MASK = 0x0F;
+
+    // v2 files keep the v1 fields with width, height and payload size zeroed
+    // (so v1 readers see an empty image) and extend the header to 28 bytes:
+    // u16 version, u16 tile size, u32 width, u32 height, u8 compression,
+    // u8 layout and two reserved bytes. The palette follows, then the data
+    // of the layout.
+    inline constexpr int V2_HEADER_SIZE = 28;
+    // The height is the one field patched after the payload, by writers
+    // that learn it only at the end.
+    inline constexpr int V2_HEIGHT_OFFSET = 20;
+    inline constexpr int V2_VERSION = 2;
+
+    // Square tiles located through a tile offset table.
+    inline constexpr int LAYOUT_TILES = 0;
+    // Full-width strips of tileSize rows stored back to back without a
+    // table, the last one possibly shorter; written by the streaming writer.
+    inline constexpr int LAYOUT_ROW_STRIPS = 1;
+    // A sequence of frames sharing the palette: the first one stored whole,
+    // the rest as XOR deltas of the changed blocks. The tile size field
+    // holds the block width.
+    inline constexpr int LAYOUT_FRAMES = 2;
+
+    // RGBA (R in the low byte) for every 5-bit code, alpha always opaque.
+    inline constexpr std::array<Uint32, 32> DECODE_TABLE = [] {
+        std::array<Uint32, 32> table{};
+        for (int code = 0; code < 32; code++) {
+            Uint32 r = ((code >> 3) & 3) * 85;
+            Uint32 g = ((code >> 1) & 3) * 85;
+            Uint32 b = ((code >> 0) & 1) * 255;
+            table[code] = r | (g << 8) | (b << 16) | 0xFF000000u;
+        }
+        return table;
+    }();
+
+    // Transposes an 8x8 bit matrix stored one row per byte (row i in byte i,
+    // column j in bit j). Turning 8 pixel codes into bit planes and back is
+    // the same operation, so encoder and decoder share it.
+    inline Uint64 transpose8x8(Uint64 x) {
+        Uint64 t;
+        t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+        x ^= t ^ (t << 7);
+        t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+        x ^= t ^ (t << 14);
+        t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+        x ^= t ^ (t << 28);
+        return x;
+    }
+
+    inline void packBlock(const Uint8* pixels, Uint8* outputBytes) {
+        Uint64 rows;
+        std::memcpy(&rows, pixels, sizeof(rows));
+        Uint64 planes = transpose8x8(rows);
+        std::memcpy(outputBytes, &planes, BYTES_PER_BLOCK);
+    }
+
+    inline void unpackBlock(const Uint8* inputBytes, Uint8* pixels) {
+        Uint64 planes = 0;
+        std::memcpy(&planes, inputBytes, BYTES_PER_BLOCK);
+        Uint64 rows = transpose8x8(planes);
+        std::memcpy(pixels, &rows, sizeof(rows));
+    }
+
+    inline int columnCount(int width) {
+        return (width + PIXELS_PER_BLOCK - 1) / PIXELS_PER_BLOCK;
+    }
+
+    // Mask selecting the given number of most significant planes.
+    inline int topPlanesMask(int planes) {
+        return (0x1F << (PLANE_COUNT - planes)) & 0x1F;
+    }
+
+    // Rectangle of the image covered by one block payload: the whole image in
+    // a v1 file, one tile in a v2 file. Blocks are stored column strip by
+    // column strip, height blocks per strip.
+    struct BlockRegion {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+
+        int columns() const { return columnCount(width); }
+        size_t blockCount() const { return static_cast<size_t>(columns()) * height; }
+        size_t blockIndex(int col, int row) const { return static_cast<size_t>(col) * height + row; }
+    };
+
+    // Where the plane bytes of a block live in the payload: byte b of block
+    // i is at i * blockStep + planeOffset[b].
+    struct BlockLayout {
+        size_t blockStep;
+        size_t planeOffset[PLANE_COUNT];
+
+        static BlockLayout interleaved() {
+            return {BYTES_PER_BLOCK, {0, 1, 2, 3, 4}};
+        }
+
+        static BlockLayout planar(size_t blockCount) {
+            return {1, {4 * blockCount, 3 * blockCount, 2 * blockCount, blockCount, 0}};
+        }
+
+        void store(Uint8* payload, size_t block, const Uint8* bytes) const {
+            Uint8* base = payload + block * blockStep;
+            for (int b = 0; b < PLANE_COUNT; b++) {
+                base[planeOffset[b]] = bytes[b];
+            }
+        }
+
+        // Planes outside planeMask (bit b for plane b) read as zero.
+        void load(const Uint8* payload, size_t block, int planeMask, Uint8* bytes) const {
+            const Uint8* base = payload + block * blockStep;
+            for (int b = 0; b < PLANE_COUNT; b++) {
+                bytes[b] = (planeMask >> b) & 1 ? base[planeOffset[b]] : 0;
+            }
+        }
+    };
+
+    // RGBA destination covering [x, x + width) x [y, y + height) of the
+    // image, rows stride pixels apart. Pixels outside it are skipped.
+    struct PixelWindow {
+        Uint32* pixels;
+        size_t stride;
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    // Rows processed together per column strip. Each column stores its rows
+    // contiguously, so a strip of rows reads STRIP_ROWS short runs from the
+    // image and writes one STRIP_ROWS * 5 byte run per column, keeping both
+    // the pixel side and the block side sequential.
+    inline constexpr int STRIP_ROWS = 16;
+
+    // Smallest number of 8-pixel blocks worth handing to another thread.
+    inline constexpr int MIN_BLOCKS_PER_TASK = 16384;
+
+    inline int minColumnsPerTask(int height) {
+        return std::max(1, MIN_BLOCKS_PER_TASK / std::max(1, height));
+    }
+
+    // Fills codes[0..count) with the indices of row y starting at startX.
+    struct IndexCodes {
+        std::span<const std::uint8_t> indices;
+        int width;
+
+        void operator()(int y, int startX, int count, Uint8* codes) const {
+            const std::uint8_t* row = indices.data() + static_cast<size_t>(y) * width + startX;
+            for (int i = 0; i < count; i++) {
+                codes[i] = row[i] & 31;
+            }
+        }
+    };
+
+    // RowCodes is called as rowCodes(y, startX, count, codes) with image
+    // coordinates and fills the codes of up to 8 pixels.
+    template <typename RowCodes>
+    void encodeColumns(const RowCodes& rowCodes, const BlockRegion& region, int firstCol, int lastCol, const BlockLayout& layout, Uint8* blocks) {
+        for (int y0 = 0; y0 < region.height; y0 += STRIP_ROWS) {
+            int y1 = std::min(region.height, y0 + STRIP_ROWS);
+
+            for (int col = firstCol; col < lastCol; col++) {
+                int startX = col * PIXELS_PER_BLOCK;
+                int count = std::min(PIXELS_PER_BLOCK, region.width - startX);
+                size_t block = region.blockIndex(col, y0);
+
+                for (int y = y0; y < y1; y++, block++) {
+                    Uint8 pixels[8] = {0};
+                    Uint8 output[BYTES_PER_BLOCK];
+                    rowCodes(region.y + y, region.x + startX, count, pixels);
+                    packBlock(pixels, output);
+                    layout.store(blocks, block, output);
+                }
+            }
+        }
+    }
+
+    inline void decodeColumns(const Uint8* blocks, const BlockRegion& region, int firstCol, int lastCol, const BlockLayout& layout, int planeMask, const Uint32* table, const PixelWindow& out) {
+        int rowBegin = std::max(0, out.y - region.y);
+        int rowEnd = std::min(region.height, out.y + out.height - region.y);
+
+        for (int y0 = rowBegin; y0 < rowEnd; y0 += STRIP_ROWS) {
+            int y1 = std::min(rowEnd, y0 + STRIP_ROWS);
+
+            for (int col = firstCol; col < lastCol; col++) {
+                int startX = region.x + col * PIXELS_PER_BLOCK;
+                int first = std::max(startX, out.x) - startX;
+                int last = std::min({startX + PIXELS_PER_BLOCK, region.x + region.width, out.x + out.width}) - startX;
+                if (first >= last) continue;
+
+                size_t block = region.blockIndex(col, y0);
+                for (int y = y0; y < y1; y++, block++) {
+                    Uint8 input[BYTES_PER_BLOCK];
+                    Uint8 codes[8];
+                    layout.load(blocks, block, planeMask, input);
+                    unpackBlock(input, codes);
+
+                    Uint32* row = out.pixels + static_cast<size_t>(region.y + y - out.y) * out.stride + (startX - out.x);
+                    for (int i = first; i < last; i++) {
+                        row[i] = table[codes[i]];
+                    }
+                }
+            }
+        }
+    }
+
+    // Subsampled RGBA destination: output pixel (i, j) is the image pixel
+    // (xs[i], ys[j]), both lists ascending, output rows xs.size() apart.
+    struct SampleGrid {
+        std::span<const int> xs;
+        std::span<const int> ys;
+        Uint32* pixels;
+
+        // Indices of the samples along one axis that fall in [begin, end).
+        static std::pair<size_t, size_t> within(std::span<const int> at, int begin, int end) {
+            return {static_cast<size_t>(std::lower_bound(at.begin(), at.end(), begin) - at.begin()),
+                static_cast<size_t>(std::lower_bound(at.begin(), at.end(), end) - at.begin())};
+        }
+    };
+
+    // Writes sample columns [firstX, lastX), which must lie inside the
+    // region, for every sample row inside it. Only the 5 plane bits of each
+    // sampled pixel are read from its block.
+    inline void sampleColumns(const Uint8* blocks, const BlockRegion& region, size_t firstX, size_t lastX, const BlockLayout& layout, const Uint32* table, const SampleGrid& grid) {
+        auto [firstY, lastY] = SampleGrid::within(grid.ys, region.y, region.y + region.height);
+
+        for (size_t i = firstX; i < lastX; i++) {
+            int x = grid.xs[i] - region.x;
+            int col = x / PIXELS_PER_BLOCK;
+            int bit = x % PIXELS_PER_BLOCK;
+
+            for (size_t j = firstY; j < lastY; j++) {
+                Uint8 planes[BYTES_PER_BLOCK];
+                layout.load(blocks, region.blockIndex(col, grid.ys[j] - region.y), 0x1F, planes);
+
+                int code = 0;
+                for (int b = 0; b < PLANE_COUNT; b++) {
+                    code |= ((planes[b] >> bit) & 1) << b;
+                }
+                grid.pixels[j * grid.xs.size() + i] = table[code];
+            }
+        }
+    }
+
+    // Palette entries are stored as R, G, B. Entries past the end of a short
+    // palette are written as zeros so the size never changes.
+    inline void writePalette(std::span<const std::uint32_t> palette, Uint8* out) {
+        std::memset(out, 0, PALETTE_SIZE);
+        for (size_t i = 0; i < palette.size() && i < PALETTE_COLORS; i++) {
+            *out++ = palette[i] & 0xFF;
+            *out++ = (palette[i] >> 8) & 0xFF;
+            *out++ = (palette[i] >> 16) & 0xFF;
+        }
+    }
+
+    inline std::array<Uint32, 32> readPalette(const Uint8* entry) {
+        std::array<Uint32, 32> table{};
+        for (auto& color: table) {
+            color = entry[0] | (entry[1] << 8) | (entry[2] << 16) | 0xFF000000u;
+            entry += 3;
+        }
+        return table;
+    }
+
+    // Fixed fields of a v1 or v2 DG5 header.
+    struct Header {
+        int version = 1;
+        int width = 0;
+        int height = 0;
+        int modeByte = 0;
+        int dithering = 0;
+        // v2 only
+        int tileSize = 0;
+        int compression = 0;
+        int layout = LAYOUT_TILES;
+        // Start of the palette, followed by the block payload (v1) or the
+        // tile offset table (v2).
+        size_t paletteOffset = HEADER_SIZE;
+
+        int mode() const { return modeByte & MODE_MASK; }
+        bool planar() const { return modeByte & FLAG_PLANAR; }
+        std::array<Uint32, 32> decodeTable(std::span<const std::byte> data) const;
+    };
+
+    // Throws std::invalid_argument when data does not start with a DG5 header.
+    Header parseHeader(std::span<const std::byte> data);
+
+    // Writes the V2_HEADER_SIZE bytes of a v2 header.
+    void writeHeaderV2(Uint8* out, int width, int height, int tileSize, int modeByte, int dithering, int compression, int layout);
+
+    // Fill a sample grid from a v2 file of the matching layout (the first
+    // frame for LAYOUT_FRAMES), reading only the blocks that hold samples.
+    // Each is defined next to the decoder of its layout.
+    void sampleTiled(std::span<const std::byte> data, const SampleGrid& grid);
+    void sampleStrips(std::span<const std::byte> data, const SampleGrid& grid);
+    void sampleFirstFrame(std::span<const std::byte> data, const SampleGrid& grid);
+}
@@ -0,0 +1,173 @@
+#include "DG5Catalog.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "DG5Blocks.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+namespace {
+    // Index file: "DGCI", u32 version, u32 entry count, then for every entry
+    // u64 file size, u32 width, u32 height, u8 DG5 version, u8 mode byte
+    // (mode and flags as stored in DG5 files), u8 dithering, u8 reserved,
+    // u16 path length and the UTF-8 path relative to the directory.
+    constexpr char CATALOG_MAGIC[4] = {'D', 'G', 'C', 'I'};
+    constexpr Uint32 CATALOG_VERSION = 1;
+    constexpr size_t ENTRY_FIXED_SIZE = 8 + 4 + 4 + 4 + 2;
+
+    template <typename T>
+    void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    T get(const std::string& in, size_t& offset) {
+        if (in.size() - offset < sizeof(T)) {
+            throw std::invalid_argument("Truncated DG5 catalog");
+        }
+        T value;
+        std::memcpy(&value, in.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    bool isDG5(const std::filesystem::directory_entry& entry) {
+        if (!entry.is_regular_file()) return false;
+
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension == ".dg5";
+    }
+
+    template <typename Iterator>
+    void collect(Iterator iterator, std::vector<std::filesystem::path>& paths) {
+        for (const auto& entry: iterator) {
+            if (isDG5(entry)) {
+                paths.push_back(entry.path());
+            }
+        }
+    }
+}
+
+std::vector<fileManagement::CatalogEntry> fileManagement::buildCatalog(const std::filesystem::path& directory, const std::filesystem::path& indexPath, bool recursive) {
+    std::vector<std::filesystem::path> paths;
+    if (recursive) {
+        collect(std::filesystem::recursive_directory_iterator(directory), paths);
+    } else {
+        collect(std::filesystem::directory_iterator(directory), paths);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<std::optional<CatalogEntry>> probed(paths.size());
+    Parallel::For(static_cast<int>(paths.size()), 16, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            try {
+                DG5Info info = probeFile(paths[i]);
+                CatalogEntry entry;
+                entry.path = paths[i].lexically_relative(directory);
+                entry.fileSize = std::filesystem::file_size(paths[i]);
+                entry.version = info.version;
+                entry.width = info.width;
+                entry.height = info.height;
+                entry.mode = info.mode;
+                entry.dithering = info.dithering;
+                entry.indexed = info.indexed;
+                entry.planar = info.planar;
+                probed[i] = entry;
+            } catch (const std::exception&) {
+                // Not a DG5 file after all, or unreadable: leave it out.
+            }
+        }
+    });
+
+    std::vector<CatalogEntry> entries;
+    for (auto& entry: probed) {
+        if (entry) {
+            entries.push_back(std::move(*entry));
+        }
+    }
+
+    std::string out(CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    put<Uint32>(out, CATALOG_VERSION);
+    put<Uint32>(out, static_cast<Uint32>(entries.size()));
+    for (const CatalogEntry& entry: entries) {
+        auto path = entry.path.generic_u8string();
+        if (path.size() > 0xFFFF) {
+            throw std::invalid_argument("Path too long for a DG5 catalog");
+        }
+
+        int modeByte = entry.mode | (entry.indexed ? FLAG_INDEXED : 0) | (entry.planar ? FLAG_PLANAR : 0);
+        put<Uint64>(out, entry.fileSize);
+        put<Uint32>(out, static_cast<Uint32>(entry.width));
+        put<Uint32>(out, static_cast<Uint32>(entry.height));
+        put<Uint8>(out, static_cast<Uint8>(entry.version));
+        put<Uint8>(out, static_cast<Uint8>(modeByte));
+        put<Uint8>(out, static_cast<Uint8>(entry.dithering));
+        put<Uint8>(out, 0);
+        put<Uint16>(out, static_cast<Uint16>(path.size()));
+        out.append(reinterpret_cast<const char*>(path.data()), path.size());
+    }
+
+    std::ofstream file(indexPath, std::ios::binary);
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+    file.write(out.data(), out.size());
+    file.close();
+
+    return entries;
+}
+
+std::vector<fileManagement::CatalogEntry> fileManagement::readCatalog(const std::filesystem::path& indexPath) {
+    std::ifstream file(indexPath, std::ios::binary);
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+
+    std::string in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (in.size() < sizeof(CATALOG_MAGIC) || std::memcmp(in.data(), CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0) {
+        throw std::invalid_argument("Not a DG5 catalog");
+    }
+
+    size_t offset = sizeof(CATALOG_MAGIC);
+    if (get<Uint32>(in, offset) != CATALOG_VERSION) {
+        throw std::invalid_argument("Unsupported DG5 catalog version");
+    }
+
+    Uint32 count = get<Uint32>(in, offset);
+    std::vector<CatalogEntry> entries;
+    entries.reserve(std::min<size_t>(count, (in.size() - offset) / ENTRY_FIXED_SIZE));
+
+    for (Uint32 i = 0; i < count; i++) {
+        CatalogEntry entry;
+        entry.fileSize = get<Uint64>(in, offset);
+        entry.width = static_cast<int>(get<Uint32>(in, offset));
+        entry.height = static_cast<int>(get<Uint32>(in, offset));
+        entry.version = get<Uint8>(in, offset);
+        int modeByte = get<Uint8>(in, offset);
+        entry.dithering = get<Uint8>(in, offset);
+        get<Uint8>(in, offset);
+        Uint16 length = get<Uint16>(in, offset);
+        if (in.size() - offset < length) {
+            throw std::invalid_argument("Truncated DG5 catalog");
+        }
+
+        entry.mode = modeByte & MODE_MASK;
+        entry.indexed = modeByte & FLAG_INDEXED;
+        entry.planar = modeByte & FLAG_PLANAR;
+        entry.path = std::u8string(reinterpret_cast<const char8_t*>(in.data() + offset), length);
+        offset += length;
+        entries.push_back(std::move(entry));
+    }
+
+    return entries;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "fileManagement.h"
+
+namespace fileManagement {
+    // One DG5 file of a catalogued directory. The palette isn't kept; use
+    // probeFile when it's needed.
+    struct CatalogEntry {
+        // Relative to the catalogued directory.
+        std::filesystem::path path;
+        std::uint64_t fileSize = 0;
+        int version = 1;
+        int width = 0;
+        int height = 0;
+        int mode = 0;
+        int dithering = 0;
+        bool indexed = false;
+        bool planar = false;
+    };
+
+    // Probes every .dg5 file of directory in parallel and writes the header
+    // fields to a compact index file, so later listings don't open the
+    // files. Files that aren't valid DG5 are left out. Entries are sorted by
+    // path. Returns the entries written.
+    std::vector<CatalogEntry> buildCatalog(const std::filesystem::path& directory, const std::filesystem::path& indexPath, bool recursive = false);
+
+    std::vector<CatalogEntry> readCatalog(const std::filesystem::path& indexPath);
+}
@@ -0,0 +1,193 @@
+#include "DG5Compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 0xFFFF;
+    const int HASH_BITS = 14;
+
+    // The last bytes are always literals so the decoder's copies stay simple.
+    const size_t LAST_LITERALS = 5;
+
+    std::uint32_t read32(const std::uint8_t* p) {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    size_t hash4(std::uint32_t value) {
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    size_t matchLength(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* end) {
+        const std::uint8_t* start = b;
+        while (b < end && *a == *b) {
+            a++;
+            b++;
+        }
+        return b - start;
+    }
+
+    void writeLength(std::vector<std::uint8_t>& output, size_t length) {
+        for (; length >= 255; length -= 255) {
+            output.push_back(255);
+        }
+        output.push_back(static_cast<std::uint8_t>(length));
+    }
+
+    void writeToken(std::vector<std::uint8_t>& output, const std::uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+        size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+        std::uint8_t token = static_cast<std::uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+        output.push_back(token);
+
+        if (literalCount >= 15) {
+            writeLength(output, literalCount - 15);
+        }
+        output.insert(output.end(), literals, literals + literalCount);
+
+        if (matchLength) {
+            output.push_back(static_cast<std::uint8_t>(offset));
+            output.push_back(static_cast<std::uint8_t>(offset >> 8));
+            if (matchCode >= 15) {
+                writeLength(output, matchCode - 15);
+            }
+        }
+    }
+
+    size_t readLength(const std::uint8_t*& in, const std::uint8_t* end) {
+        size_t length = 0;
+        std::uint8_t byte;
+        do {
+            if (in == end) {
+                throw std::invalid_argument("Corrupt DG5 compressed chunk");
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return length;
+    }
+}
+
+bool fileManagement::detail::compressChunk(std::span<const std::uint8_t> input, std::vector<std::uint8_t>& output) {
+    std::vector<std::uint8_t> result;
+    result.reserve(input.size() / 2);
+
+    const std::uint8_t* base = input.data();
+    const std::uint8_t* end = base + input.size();
+    const std::uint8_t* matchLimit = input.size() > LAST_LITERALS ? end - LAST_LITERALS : base;
+    const std::uint8_t* literals = base;
+    const std::uint8_t* p = base;
+
+    std::vector<std::uint32_t> table(size_t(1) << HASH_BITS, 0);
+
+    while (p + MIN_MATCH <= matchLimit) {
+        size_t position = p - base;
+        size_t bestLength = 0;
+        size_t bestOffset = 0;
+
+        // Runs of one byte and repeated 5-byte blocks first, then the hash chain head.
+        for (size_t offset : {size_t(1), size_t(5)}) {
+            if (position >= offset) {
+                size_t length = matchLength(p - offset, p, matchLimit);
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestOffset = offset;
+                }
+            }
+        }
+
+        std::uint32_t value = read32(p);
+        size_t slot = hash4(value);
+        size_t candidate = table[slot];
+        table[slot] = static_cast<std::uint32_t>(position);
+
+        if (candidate < position && position - candidate <= MAX_OFFSET && read32(base + candidate) == value) {
+            size_t length = matchLength(base + candidate, p, matchLimit);
+            if (length > bestLength) {
+                bestLength = length;
+                bestOffset = position - candidate;
+            }
+        }
+
+        if (bestLength < MIN_MATCH) {
+            p++;
+            continue;
+        }
+
+        writeToken(result, literals, p - literals, bestOffset, bestLength);
+        p += bestLength;
+        literals = p;
+
+        if (result.size() >= input.size()) {
+            return false;
+        }
+    }
+
+    writeToken(result, literals, end - literals, 0, 0);
+
+    if (result.size() >= input.size()) {
+        return false;
+    }
+
+    output = std::move(result);
+    return true;
+}
+
+void fileManagement::detail::decompressChunk(std::span<const std::uint8_t> input, std::span<std::uint8_t> output) {
+    const std::uint8_t* in = input.data();
+    const std::uint8_t* inEnd = in + input.size();
+    std::uint8_t* out = output.data();
+    std::uint8_t* outEnd = out + output.size();
+
+    while (true) {
+        if (in == inEnd) {
+            throw std::invalid_argument("Corrupt DG5 compressed chunk");
+        }
+
+        std::uint8_t token = *in++;
+        size_t literalCount = token >> 4;
+        if (literalCount == 15) {
+            literalCount += readLength(in, inEnd);
+        }
+
+        if (literalCount > static_cast<size_t>(inEnd - in) || literalCount > static_cast<size_t>(outEnd - out)) {
+            throw std::invalid_argument("Corrupt DG5 compressed chunk");
+        }
+        std::copy_n(in, literalCount, out);
+        in += literalCount;
+        out += literalCount;
+
+        if (in == inEnd) {
+            break;
+        }
+
+        if (inEnd - in < 2) {
+            throw std::invalid_argument("Corrupt DG5 compressed chunk");
+        }
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        size_t length = (token & 15) + MIN_MATCH;
+        if ((token & 15) == 15) {
+            length += readLength(in, inEnd);
+        }
+
+        if (offset == 0 || offset > static_cast<size_t>(out - output.data()) || length > static_cast<size_t>(outEnd - out)) {
+            throw std::invalid_argument("Corrupt DG5 compressed chunk");
+        }
+
+        // Byte by byte: the source may overlap the bytes being written.
+        const std::uint8_t* from = out - offset;
+        for (size_t i = 0; i < length; i++) {
+            out[i] = from[i];
+        }
+        out += length;
+    }
+
+    if (out != outEnd) {
+        throw std::invalid_argument("Corrupt DG5 compressed chunk");
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+// Byte-oriented LZ77 codec for DG5 block payloads. Not part of the public
+// fileManagement API.
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace fileManagement::detail {
+    // Compresses one chunk (a v2 tile). Returns false and leaves output
+    // untouched when the result would not be smaller than the input, in
+    // which case the chunk is stored raw; readers tell the two apart by
+    // comparing the stored size with the raw size.
+    //
+    // The stream is a sequence of tokens. A token byte holds the literal
+    // count in its high nibble and the match length minus 4 in its low
+    // nibble, 15 meaning that more length bytes follow (each adds up to 255,
+    // ending with a byte below 255). The literals follow, then a 16-bit
+    // little-endian match offset and the extra match length bytes. The last
+    // token has literals only. Runs of equal bytes, typical for flat bit
+    // planes, are matches at offset 1; repeated 5-byte blocks are matches at
+    // offset 5.
+    bool compressChunk(std::span<const std::uint8_t> input, std::vector<std::uint8_t>& output);
+
+    // Throws std::invalid_argument unless input decodes to exactly output.size() bytes.
+    void decompressChunk(std::span<const std::uint8_t> input, std::span<std::uint8_t> output);
+}
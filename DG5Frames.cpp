@@ -0,0 +1,271 @@
+#include "DG5Frames.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "DG5Blocks.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+namespace {
+    // Frame count (u32, then 4 bytes of padding) and the frame offset table
+    // follow the palette.
+    size_t countOffset() {
+        return V2_HEADER_SIZE + PALETTE_SIZE;
+    }
+
+    size_t tableOffset() {
+        return countOffset() + 8;
+    }
+
+    size_t bitmapSize(size_t blockCount) {
+        return (blockCount + 7) / 8;
+    }
+
+    Header parseFramesHeader(std::span<const std::byte> bytes) {
+        Header header = parseHeader(bytes);
+        if (header.version != V2_VERSION || header.layout != LAYOUT_FRAMES || header.compression != 0) {
+            throw std::invalid_argument("Not a multi-frame DG5 file");
+        }
+        return header;
+    }
+
+    // Reads the frame offset table (frame count + 1 entries, the last one
+    // the end of the data) and checks that every record lies inside the
+    // data and that the first frame has the size of a whole image.
+    std::vector<Uint64> readOffsets(std::span<const std::byte> bytes, const Header& header) {
+        if (bytes.size() < tableOffset()) {
+            throw std::invalid_argument("Truncated DG5 frame table");
+        }
+
+        Uint32 count32 = 0;
+        std::memcpy(&count32, bytes.data() + countOffset(), sizeof(count32));
+        if (count32 == 0 || (bytes.size() - tableOffset()) / sizeof(Uint64) < static_cast<size_t>(count32) + 1) {
+            throw std::invalid_argument("Truncated DG5 frame table");
+        }
+
+        std::vector<Uint64> offsets(static_cast<size_t>(count32) + 1);
+        std::memcpy(offsets.data(), bytes.data() + tableOffset(), offsets.size() * sizeof(Uint64));
+        for (size_t i = 0; i + 1 < offsets.size(); i++) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > bytes.size()) {
+                throw std::invalid_argument("Corrupt DG5 frame table");
+            }
+        }
+
+        BlockRegion region{0, 0, header.width, header.height};
+        if (offsets[1] - offsets[0] != region.blockCount() * BYTES_PER_BLOCK) {
+            throw std::invalid_argument("Corrupt DG5 frame table");
+        }
+        return offsets;
+    }
+
+    void encodeFrame(const IndexedImage& frame, const BlockRegion& region, Uint8* blocks) {
+        IndexCodes codes{frame.indices, frame.width};
+        Parallel::For(region.columns(), minColumnsPerTask(region.height), [&](int begin, int end) {
+            encodeColumns(codes, region, begin, end, BlockLayout::interleaved(), blocks);
+        });
+    }
+
+    // Appends the changed-block bitmap and the XOR of every changed block.
+    void appendDelta(const std::vector<Uint8>& previous, const std::vector<Uint8>& current, size_t blockCount, std::vector<std::byte>& output) {
+        size_t bitmapStart = output.size();
+        output.resize(bitmapStart + bitmapSize(blockCount));
+
+        for (size_t group = 0; group * 8 < blockCount; group++) {
+            size_t first = group * 8;
+            size_t count = std::min<size_t>(8, blockCount - first);
+            const Uint8* before = previous.data() + first * BYTES_PER_BLOCK;
+            const Uint8* after = current.data() + first * BYTES_PER_BLOCK;
+
+            // Most groups of a slowly changing sequence are unchanged.
+            if (std::memcmp(before, after, count * BYTES_PER_BLOCK) == 0) continue;
+
+            Uint8 mask = 0;
+            for (size_t i = 0; i < count; i++) {
+                const Uint8* a = before + i * BYTES_PER_BLOCK;
+                const Uint8* b = after + i * BYTES_PER_BLOCK;
+                if (std::memcmp(a, b, BYTES_PER_BLOCK) == 0) continue;
+
+                mask |= 1 << i;
+                for (int j = 0; j < BYTES_PER_BLOCK; j++) {
+                    output.push_back(static_cast<std::byte>(a[j] ^ b[j]));
+                }
+            }
+            output[bitmapStart + group] = static_cast<std::byte>(mask);
+        }
+    }
+}
+
+std::vector<std::byte> fileManagement::encodeFrames(std::span<const IndexedImage> frames, int mode, int dithering) {
+    if (frames.empty()) {
+        throw std::invalid_argument("No frames to encode");
+    }
+
+    int width = frames[0].width;
+    int height = frames[0].height;
+    if (frames[0].palette.size() > PALETTE_COLORS) {
+        throw std::invalid_argument("DG5 palettes hold at most 32 colours");
+    }
+
+    // Only one palette is stored and codes are 5 bits, so anything else
+    // would decode with the wrong colours.
+    for (const IndexedImage& frame: frames) {
+        if (frame.width != width || frame.height != height
+            || frame.indices.size() != static_cast<size_t>(width) * height) {
+            throw std::invalid_argument("Frames differ in size");
+        }
+        if (frame.palette != frames[0].palette) {
+            throw std::invalid_argument("Frames differ in palette");
+        }
+        if (std::any_of(frame.indices.begin(), frame.indices.end(),
+                [](std::uint8_t index) { return index >= PALETTE_COLORS; })) {
+            throw std::invalid_argument("Palette index out of range");
+        }
+    }
+
+    BlockRegion region{0, 0, width, height};
+    size_t blockCount = region.blockCount();
+    size_t frameCount = frames.size();
+    std::vector<Uint64> offsets(frameCount + 1);
+
+    std::vector<std::byte> output(tableOffset() + offsets.size() * sizeof(Uint64));
+    Uint8* out = reinterpret_cast<Uint8*>(output.data());
+    Uint32 count32 = static_cast<Uint32>(frameCount);
+    writeHeaderV2(out, width, height, PIXELS_PER_BLOCK, (mode & MODE_MASK) | FLAG_INDEXED, dithering, 0, LAYOUT_FRAMES);
+    writePalette(frames[0].palette, out + V2_HEADER_SIZE);
+    std::memcpy(out + countOffset(), &count32, sizeof(count32));
+
+    std::vector<Uint8> previous(blockCount * BYTES_PER_BLOCK);
+    std::vector<Uint8> current(blockCount * BYTES_PER_BLOCK);
+
+    for (size_t i = 0; i < frameCount; i++) {
+        offsets[i] = output.size();
+        encodeFrame(frames[i], region, current.data());
+
+        if (i == 0) {
+            const std::byte* first = reinterpret_cast<const std::byte*>(current.data());
+            output.insert(output.end(), first, first + current.size());
+        } else {
+            appendDelta(previous, current, blockCount, output);
+        }
+        std::swap(previous, current);
+    }
+    offsets[frameCount] = output.size();
+
+    std::memcpy(output.data() + tableOffset(), offsets.data(), offsets.size() * sizeof(Uint64));
+    return output;
+}
+
+void fileManagement::saveToFileFrames(std::span<const IndexedImage> frames, std::filesystem::path path, int mode, int dithering) {
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+
+    std::vector<std::byte> encoded = encodeFrames(frames, mode, dithering);
+    file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+
+    file.close();
+}
+
+fileManagement::FrameReader::FrameReader(std::span<const std::byte> bytes) : data(bytes) {
+    Header header = parseFramesHeader(bytes);
+    offsets = readOffsets(bytes, header);
+
+    BlockRegion region{0, 0, header.width, header.height};
+    table = header.decodeTable(bytes);
+    blocks.resize(region.blockCount() * BYTES_PER_BLOCK);
+    image.width = header.width;
+    image.height = header.height;
+    image.image.resize(static_cast<size_t>(image.width) * image.height * 4);
+}
+
+const fileManagement::DG5ImageData& fileManagement::FrameReader::frame(int index) {
+    if (index < 0 || index >= frameCount()) {
+        throw std::invalid_argument("Frame index out of range");
+    }
+
+    if (index < current) {
+        current = -1;
+    }
+    while (current < index) {
+        // A corrupt delta leaves the blocks half updated; start over next time.
+        int next = current + 1;
+        current = -1;
+        applyFrame(next);
+        current = next;
+    }
+
+    return image;
+}
+
+void fileManagement::FrameReader::applyFrame(int index) {
+    BlockRegion region{0, 0, image.width, image.height};
+    const Uint8* record = reinterpret_cast<const Uint8*>(data.data()) + offsets[index];
+    size_t recordSize = offsets[index + 1] - offsets[index];
+    Uint32* pixels = reinterpret_cast<Uint32*>(image.image.data());
+
+    if (index == 0) {
+        std::memcpy(blocks.data(), record, blocks.size());
+
+        PixelWindow out{pixels, static_cast<size_t>(image.width), 0, 0, image.width, image.height};
+        Parallel::For(region.columns(), minColumnsPerTask(region.height), [&](int begin, int end) {
+            decodeColumns(blocks.data(), region, begin, end, BlockLayout::interleaved(), 0x1F, table.data(), out);
+        });
+        return;
+    }
+
+    size_t blockCount = region.blockCount();
+    size_t bitmapBytes = bitmapSize(blockCount);
+    if (recordSize < bitmapBytes) {
+        throw std::invalid_argument("Truncated DG5 frame");
+    }
+
+    const Uint8* bitmap = record;
+    const Uint8* delta = record + bitmapBytes;
+    const Uint8* deltaEnd = record + recordSize;
+
+    for (size_t group = 0; group < bitmapBytes; group++) {
+        unsigned mask = bitmap[group];
+        while (mask != 0) {
+            size_t block = group * 8 + std::countr_zero(mask);
+            mask &= mask - 1;
+            if (block >= blockCount || deltaEnd - delta < BYTES_PER_BLOCK) {
+                throw std::invalid_argument("Corrupt DG5 frame");
+            }
+
+            Uint8* packed = blocks.data() + block * BYTES_PER_BLOCK;
+            for (int j = 0; j < BYTES_PER_BLOCK; j++) {
+                packed[j] ^= *delta++;
+            }
+
+            Uint8 codes[8];
+            unpackBlock(packed, codes);
+            int x = static_cast<int>(block / region.height) * PIXELS_PER_BLOCK;
+            int y = static_cast<int>(block % region.height);
+            int count = std::min(PIXELS_PER_BLOCK, region.width - x);
+            Uint32* row = pixels + static_cast<size_t>(y) * region.width + x;
+            for (int i = 0; i < count; i++) {
+                row[i] = table[codes[i]];
+            }
+        }
+    }
+}
+
+void fileManagement::detail::sampleFirstFrame(std::span<const std::byte> data, const SampleGrid& grid) {
+    Header header = parseFramesHeader(data);
+    std::vector<Uint64> offsets = readOffsets(data, header);
+
+    BlockRegion region{0, 0, header.width, header.height};
+    auto table = header.decodeTable(data);
+    const Uint8* blocks = reinterpret_cast<const Uint8*>(data.data()) + offsets[0];
+
+    Parallel::For(static_cast<int>(grid.xs.size()), minColumnsPerTask(static_cast<int>(grid.ys.size())), [&](int begin, int end) {
+        sampleColumns(blocks, region, begin, end, BlockLayout::interleaved(), table.data(), grid);
+    });
+}
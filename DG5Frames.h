@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "IndexedImage.h"
+#include "fileManagement.h"
+
+namespace fileManagement {
+    // Multi-frame DG5 v2 container for animations and captures that share a
+    // palette. The palette is stored once; the first frame is stored whole
+    // and every later frame as a bitmap of the blocks that differ from the
+    // previous frame plus the XOR of their 5 plane bytes. A table of frame
+    // offsets follows the palette.
+    //
+    // All frames must have the same size and the same palette of at most 32
+    // colours, with every index below 32; std::invalid_argument otherwise.
+    std::vector<std::byte> encodeFrames(std::span<const IndexedImage> frames, int mode, int dithering);
+    void saveToFileFrames(std::span<const IndexedImage> frames, std::filesystem::path path, int mode, int dithering);
+
+    // Plays back a multi-frame file. The packed blocks of the current frame
+    // are kept, so stepping to the next frame only XORs and re-expands the
+    // blocks that changed. Going backwards restarts from the first frame.
+    // decode and loadFromFile return the first frame.
+    class FrameReader {
+    public:
+        explicit FrameReader(std::span<const std::byte> data);
+
+        int frameCount() const { return static_cast<int>(offsets.size()) - 1; }
+        int width() const { return image.width; }
+        int height() const { return image.height; }
+
+        // The returned image stays valid until the next call.
+        const DG5ImageData& frame(int index);
+
+    private:
+        void applyFrame(int index);
+
+        std::span<const std::byte> data;
+        std::vector<std::uint64_t> offsets;
+        std::array<std::uint32_t, 32> table;
+        std::vector<std::uint8_t> blocks;
+        DG5ImageData image;
+        int current = -1;
+    };
+}
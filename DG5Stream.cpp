@@ -0,0 +1,200 @@
+#include "DG5Stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "DG5Blocks.h"
+#include "DG5Tiled.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+namespace {
+    size_t stripsOffset() {
+        return V2_HEADER_SIZE + PALETTE_SIZE;
+    }
+
+    size_t stripSize(int width, int rows) {
+        return static_cast<size_t>(columnCount(width)) * rows * BYTES_PER_BLOCK;
+    }
+}
+
+fileManagement::StreamWriter::StreamWriter(std::filesystem::path path, int width, std::span<const std::uint32_t> palette, int mode, int dithering, int stripHeight)
+    : width(width), stripHeight(stripHeight) {
+    // Checked before opening, which truncates an existing file.
+    if (width <= 0 || stripHeight <= 0 || stripHeight > 0xFFFF) {
+        throw std::invalid_argument("Invalid DG5 strip dimensions");
+    }
+
+    file.open(path, std::ios::binary);
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+    std::error_code error;
+    seekable = std::filesystem::is_regular_file(path, error);
+
+    Uint8 header[V2_HEADER_SIZE + PALETTE_SIZE];
+    writeHeaderV2(header, width, 0, stripHeight, (mode & MODE_MASK) | FLAG_INDEXED, dithering, 0, LAYOUT_ROW_STRIPS);
+    writePalette(palette, header + V2_HEADER_SIZE);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    pending.reserve(static_cast<size_t>(width) * stripHeight);
+    blocks.resize(stripSize(width, stripHeight));
+}
+
+fileManagement::StreamWriter::~StreamWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void fileManagement::StreamWriter::writeRows(std::span<const std::uint8_t> indices) {
+    if (closed) {
+        throw std::invalid_argument("DG5 stream is closed");
+    }
+    if (indices.size() % width != 0) {
+        throw std::invalid_argument("Partial row passed to DG5 stream");
+    }
+
+    size_t stripBytes = static_cast<size_t>(width) * stripHeight;
+    while (!indices.empty()) {
+        size_t count = std::min(indices.size(), stripBytes - pending.size());
+        pending.insert(pending.end(), indices.begin(), indices.begin() + count);
+        indices = indices.subspan(count);
+
+        if (pending.size() == stripBytes) {
+            flushStrip();
+        }
+    }
+}
+
+void fileManagement::StreamWriter::flushStrip() {
+    int stripRows = static_cast<int>(pending.size() / width);
+    if (stripRows == 0) return;
+
+    BlockRegion region{0, 0, width, stripRows};
+    IndexCodes codes{pending, width};
+    Parallel::For(region.columns(), minColumnsPerTask(stripRows), [&](int begin, int end) {
+        encodeColumns(codes, region, begin, end, BlockLayout::interleaved(), blocks.data());
+    });
+
+    file.write(reinterpret_cast<const char*>(blocks.data()), stripSize(width, stripRows));
+    if (!file) {
+        throw std::invalid_argument("Can't write file");
+    }
+
+    rows += stripRows;
+    pending.clear();
+}
+
+void fileManagement::StreamWriter::close() {
+    if (closed) return;
+    closed = true;
+
+    flushStrip();
+
+    if (seekable) {
+        Uint32 height32 = static_cast<Uint32>(rows);
+        file.seekp(V2_HEIGHT_OFFSET);
+        file.write(reinterpret_cast<const char*>(&height32), sizeof(height32));
+    }
+    file.close();
+    if (!file) {
+        throw std::invalid_argument("Can't write file");
+    }
+}
+
+fileManagement::DG5ImageData fileManagement::decodeStrips(std::span<const std::byte> data) {
+    Header header = parseHeader(data);
+    DG5ImageData image;
+
+    if (header.layout != LAYOUT_ROW_STRIPS || header.compression != 0) {
+        throw std::invalid_argument("Not a row-strip DG5 file");
+    }
+    if (data.size() < stripsOffset()) {
+        throw std::invalid_argument("Truncated DG5 header");
+    }
+
+    int width = header.width;
+    int stripHeight = header.tileSize;
+    size_t available = data.size() - stripsOffset();
+    size_t rowBytes = stripSize(width, 1);
+    int height = header.height;
+
+    // A writer that couldn't seek back leaves the height at 0; every row
+    // that made it to the file is complete, so count them.
+    if (height == 0 && rowBytes > 0) {
+        height = static_cast<int>(std::min<size_t>(available / rowBytes, 0x7FFFFFFF));
+    }
+
+    // Strips hold exactly rowBytes per row, so a short file is caught before
+    // a corrupt header can make the image buffer huge.
+    if (rowBytes > 0 && static_cast<size_t>(height) > available / rowBytes) {
+        throw std::invalid_argument("Truncated DG5 strip");
+    }
+    if (static_cast<Uint64>(width) * height > MAX_DECODED_PIXELS) {
+        throw std::invalid_argument("Image too large to decode at once");
+    }
+
+    image.width = width;
+    image.height = height;
+    image.image.resize(static_cast<size_t>(width) * height * 4);
+
+    auto table = header.decodeTable(data);
+    const Uint8* strips = reinterpret_cast<const Uint8*>(data.data()) + stripsOffset();
+    Uint32* pixels = reinterpret_cast<Uint32*>(image.image.data());
+
+    for (int y = 0; y < height; y += stripHeight) {
+        BlockRegion region{0, y, width, std::min(stripHeight, height - y)};
+        size_t size = stripSize(width, region.height);
+        if (available < size) {
+            throw std::invalid_argument("Truncated DG5 strip");
+        }
+
+        PixelWindow out{pixels, static_cast<size_t>(width), 0, 0, width, height};
+        Parallel::For(region.columns(), minColumnsPerTask(region.height), [&](int begin, int end) {
+            decodeColumns(strips, region, begin, end, BlockLayout::interleaved(), 0x1F, table.data(), out);
+        });
+
+        strips += size;
+        available -= size;
+    }
+
+    return image;
+}
+
+void fileManagement::detail::sampleStrips(std::span<const std::byte> data, const SampleGrid& grid) {
+    Header header = parseHeader(data);
+    if (header.layout != LAYOUT_ROW_STRIPS || header.compression != 0) {
+        throw std::invalid_argument("Not a row-strip DG5 file");
+    }
+    if (data.size() < stripsOffset()) {
+        throw std::invalid_argument("Truncated DG5 header");
+    }
+
+    auto table = header.decodeTable(data);
+    int stripHeight = header.tileSize;
+    const Uint8* strips = reinterpret_cast<const Uint8*>(data.data()) + stripsOffset();
+    size_t available = data.size() - stripsOffset();
+
+    // Every strip but the last is full, so the strip holding a row is found
+    // without reading the ones before it.
+    for (size_t j = 0; j < grid.ys.size();) {
+        int strip = grid.ys[j] / stripHeight;
+        int y = strip * stripHeight;
+        BlockRegion region{0, y, header.width, std::min(stripHeight, header.height - y)};
+        size_t offset = static_cast<size_t>(strip) * stripSize(header.width, stripHeight);
+        size_t size = stripSize(header.width, region.height);
+        if (available < offset || available - offset < size) {
+            throw std::invalid_argument("Truncated DG5 strip");
+        }
+
+        size_t next = SampleGrid::within(grid.ys, 0, region.y + region.height).second;
+        Parallel::For(static_cast<int>(grid.xs.size()), minColumnsPerTask(static_cast<int>(next - j)), [&](int begin, int end) {
+            sampleColumns(strips + offset, region, begin, end, BlockLayout::interleaved(), table.data(), grid);
+        });
+        j = next;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include "fileManagement.h"
+
+namespace fileManagement {
+    // Row-strip DG5 v2 layout for images whose height isn't known up front
+    // (piped or generated input): full-width strips of stripHeight rows, each
+    // stored like a v1 payload, follow the palette back to back. There is no
+    // tile table, so strips can be written as soon as they are complete.
+    const int DEFAULT_STRIP_HEIGHT = 16;
+
+    // Writes a row-strip DG5 file incrementally. Rows of palette indices can
+    // be passed in any batch size; only the rows of the strip in progress
+    // are buffered, so memory stays proportional to width * stripHeight.
+    // close() flushes the last, possibly shorter, strip and patches the
+    // height into the header; it throws std::invalid_argument when that
+    // fails. When the target is not a regular file (a pipe) the height
+    // stays 0 and readers infer it from the data. The destructor closes
+    // too but swallows errors.
+    class StreamWriter {
+    public:
+        StreamWriter(std::filesystem::path path, int width, std::span<const std::uint32_t> palette, int mode, int dithering, int stripHeight = DEFAULT_STRIP_HEIGHT);
+        ~StreamWriter();
+
+        StreamWriter(const StreamWriter&) = delete;
+        StreamWriter& operator=(const StreamWriter&) = delete;
+
+        // indices holds whole rows, width entries each.
+        void writeRows(std::span<const std::uint8_t> indices);
+        void close();
+
+        int rowsWritten() const { return rows; }
+
+    private:
+        void flushStrip();
+
+        std::ofstream file;
+        int width;
+        int stripHeight;
+        int rows = 0;
+        // Rows of the strip in progress and the encoded blocks of one strip.
+        std::vector<std::uint8_t> pending;
+        std::vector<std::uint8_t> blocks;
+        bool closed = false;
+        // False for pipes and other targets that can't seek back.
+        bool seekable = true;
+    };
+
+    // Decodes a whole row-strip file. decode and loadFromFile call this for
+    // row-strip data.
+    DG5ImageData decodeStrips(std::span<const std::byte> data);
+}
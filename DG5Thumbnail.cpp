@@ -0,0 +1,108 @@
+#include "DG5Thumbnail.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "DG5Blocks.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+namespace {
+    // Source pixels per thumbnail pixel along both axes.
+    int sampleStep(int width, int height, int maxWidth, int maxHeight) {
+        int stepX = (width + maxWidth - 1) / maxWidth;
+        int stepY = (height + maxHeight - 1) / maxHeight;
+        return std::max({1, stepX, stepY});
+    }
+
+    int sampleAt(int index, int step, int size) {
+        return std::min(size - 1, index * step + step / 2);
+    }
+
+    fileManagement::DG5ImageData sampleDecoded(const fileManagement::DG5ImageData& full, int step) {
+        fileManagement::DG5ImageData thumbnail;
+        thumbnail.width = (full.width + step - 1) / step;
+        thumbnail.height = (full.height + step - 1) / step;
+        thumbnail.image.resize(static_cast<size_t>(thumbnail.width) * thumbnail.height * 4);
+
+        const Uint32* source = reinterpret_cast<const Uint32*>(full.image.data());
+        Uint32* out = reinterpret_cast<Uint32*>(thumbnail.image.data());
+        for (int ty = 0; ty < thumbnail.height; ty++) {
+            const Uint32* row = source + static_cast<size_t>(sampleAt(ty, step, full.height)) * full.width;
+            for (int tx = 0; tx < thumbnail.width; tx++) {
+                *out++ = row[sampleAt(tx, step, full.width)];
+            }
+        }
+        return thumbnail;
+    }
+}
+
+fileManagement::DG5ImageData fileManagement::decodeThumbnail(std::span<const std::byte> data, int maxWidth, int maxHeight) {
+    if (maxWidth <= 0 || maxHeight <= 0) {
+        throw std::invalid_argument("Invalid thumbnail size");
+    }
+
+    Header header = parseHeader(data);
+    BlockRegion region{0, 0, header.width, header.height};
+    int step = sampleStep(header.width, header.height, maxWidth, maxHeight);
+
+    // Truncated v1 payloads and row-strip files whose height never made it
+    // into the header (written to a pipe) go through the regular decoder,
+    // which fills the missing blocks or counts the rows.
+    bool v1Complete = data.size() >= HEADER_SIZE + PALETTE_SIZE + region.blockCount() * BYTES_PER_BLOCK;
+    if ((header.version == 1 && !v1Complete)
+        || (header.version == V2_VERSION && header.layout == LAYOUT_ROW_STRIPS && header.height == 0)) {
+        return sampleDecoded(decode(data), step);
+    }
+
+    DG5ImageData thumbnail;
+    thumbnail.width = (header.width + step - 1) / step;
+    thumbnail.height = (header.height + step - 1) / step;
+    thumbnail.image.resize(static_cast<size_t>(thumbnail.width) * thumbnail.height * 4);
+
+    std::vector<int> xs(thumbnail.width);
+    std::vector<int> ys(thumbnail.height);
+    for (int tx = 0; tx < thumbnail.width; tx++) {
+        xs[tx] = sampleAt(tx, step, header.width);
+    }
+    for (int ty = 0; ty < thumbnail.height; ty++) {
+        ys[ty] = sampleAt(ty, step, header.height);
+    }
+    SampleGrid grid{xs, ys, reinterpret_cast<Uint32*>(thumbnail.image.data())};
+
+    if (header.version == V2_VERSION) {
+        switch (header.layout) {
+        case LAYOUT_ROW_STRIPS:
+            sampleStrips(data, grid);
+            break;
+        case LAYOUT_FRAMES:
+            sampleFirstFrame(data, grid);
+            break;
+        default:
+            sampleTiled(data, grid);
+            break;
+        }
+        return thumbnail;
+    }
+
+    auto table = header.decodeTable(data);
+    BlockLayout layout = header.planar() ? BlockLayout::planar(region.blockCount()) : BlockLayout::interleaved();
+    const Uint8* blocks = reinterpret_cast<const Uint8*>(data.data()) + HEADER_SIZE + PALETTE_SIZE;
+
+    // One thumbnail column reads one column strip, its rows in file order.
+    Parallel::For(thumbnail.width, minColumnsPerTask(thumbnail.height), [&](int begin, int end) {
+        sampleColumns(blocks, region, begin, end, layout, table.data(), grid);
+    });
+
+    return thumbnail;
+}
+
+fileManagement::DG5ImageData fileManagement::loadThumbnail(std::filesystem::path path, int maxWidth, int maxHeight) {
+    MappedFile file(path);
+
+    return decodeThumbnail(file.bytes(), maxWidth, maxHeight);
+}
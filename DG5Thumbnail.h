@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+#include "fileManagement.h"
+
+namespace fileManagement {
+    // Decodes a thumbnail that fits in maxWidth x maxHeight, keeping the
+    // aspect ratio. Every thumbnail pixel is one source pixel picked from
+    // the centre of its cell, its 5 plane bits read straight from the
+    // block, so only the sampled rows of the sampled column strips are
+    // touched and the cost follows the thumbnail size. Tiled v2 files only
+    // read (and decompress) the tiles holding samples; multi-frame files
+    // show their first frame. Truncated v1 files and row-strip files
+    // without a stored height are decoded whole and then sampled.
+    DG5ImageData decodeThumbnail(std::span<const std::byte> data, int maxWidth, int maxHeight);
+
+    // Maps the file so only the pages holding sampled blocks are read.
+    DG5ImageData loadThumbnail(std::filesystem::path path, int maxWidth, int maxHeight);
+}
@@ -0,0 +1,277 @@
+#include "DG5Tiled.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "DG5Blocks.h"
+#include "DG5Compression.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+namespace {
+    // Counts are 64-bit: a header holds up to 31-bit dimensions, so the
+    // tile math of a corrupt file must not overflow before it is checked.
+    struct TileGrid {
+        int width;
+        int height;
+        int tileSize;
+
+        Uint64 tilesX() const { return (static_cast<Uint64>(width) + tileSize - 1) / tileSize; }
+        Uint64 tilesY() const { return (static_cast<Uint64>(height) + tileSize - 1) / tileSize; }
+        Uint64 tileCount() const { return tilesX() * tilesY(); }
+
+        BlockRegion tile(Uint64 index) const {
+            int x = static_cast<int>(index % tilesX() * tileSize);
+            int y = static_cast<int>(index / tilesX() * tileSize);
+            return {x, y, std::min(tileSize, width - x), std::min(tileSize, height - y)};
+        }
+    };
+
+    size_t tableOffset() {
+        return V2_HEADER_SIZE + PALETTE_SIZE;
+    }
+
+    Uint64 tableSize(const TileGrid& grid) {
+        return (grid.tileCount() + 1) * sizeof(Uint64);
+    }
+
+    // Parsed v2 header plus the tile table, validated against the data size.
+    struct TiledFile {
+        Header header;
+        TileGrid grid;
+        std::span<const std::byte> data;
+
+        explicit TiledFile(std::span<const std::byte> bytes) : data(bytes) {
+            header = parseHeader(bytes);
+            if (header.version != V2_VERSION || header.layout != LAYOUT_TILES) {
+                throw std::invalid_argument("Not a tiled DG5 v2 file");
+            }
+            if (header.compression > static_cast<int>(fileManagement::Compression::Lz)) {
+                throw std::invalid_argument("Unsupported DG5 compression");
+            }
+
+            // tileCount is at most 2^48 here, so the table size can't wrap.
+            grid = {header.width, header.height, header.tileSize};
+            if (bytes.size() < tableOffset() || tableSize(grid) > bytes.size() - tableOffset()) {
+                throw std::invalid_argument("Truncated DG5 tile table");
+            }
+        }
+
+        size_t rawSize(Uint64 index) const {
+            return grid.tile(index).blockCount() * BYTES_PER_BLOCK;
+        }
+
+        // Checks that the stored chunk lies inside the data and has a
+        // plausible size: the raw size, or less for compressed files.
+        std::span<const Uint8> chunk(Uint64 index) const {
+            Uint64 begin = offset(index);
+            Uint64 end = offset(index + 1);
+            size_t expected = rawSize(index);
+
+            if (begin > end || end > data.size() || end - begin > expected
+                || (header.compression == 0 && end - begin != expected)) {
+                throw std::invalid_argument("Corrupt DG5 tile table");
+            }
+            return {reinterpret_cast<const Uint8*>(data.data()) + begin, static_cast<size_t>(end - begin)};
+        }
+
+        Uint64 offset(Uint64 index) const {
+            Uint64 value;
+            std::memcpy(&value, data.data() + tableOffset() + index * sizeof(Uint64), sizeof(value));
+            return value;
+        }
+
+        // Raw tiles are used in place, compressed ones are expanded into scratch.
+        const Uint8* tileBlocks(Uint64 index, std::vector<Uint8>& scratch) const {
+            std::span<const Uint8> stored = chunk(index);
+            if (stored.size() == rawSize(index)) {
+                return stored.data();
+            }
+
+            scratch.resize(rawSize(index));
+            decompressChunk(stored, scratch);
+            return scratch.data();
+        }
+
+        BlockLayout layout(Uint64 index) const {
+            return header.planar()
+                ? BlockLayout::planar(grid.tile(index).blockCount())
+                : BlockLayout::interleaved();
+        }
+    };
+
+    // Decodes every tile overlapping the window, one tile per task.
+    void decodeWindow(const TiledFile& file, const PixelWindow& out) {
+        const TileGrid& grid = file.grid;
+        std::array<Uint32, 32> table = file.header.decodeTable(file.data);
+
+        int firstTileX = out.x / grid.tileSize;
+        int lastTileX = (out.x + out.width - 1) / grid.tileSize;
+        int firstTileY = out.y / grid.tileSize;
+        int lastTileY = (out.y + out.height - 1) / grid.tileSize;
+        int spanX = lastTileX - firstTileX + 1;
+        int count = spanX * (lastTileY - firstTileY + 1);
+
+        Parallel::For(count, 1, [&](int begin, int end) {
+            std::vector<Uint8> scratch;
+
+            for (int i = begin; i < end; i++) {
+                Uint64 index = static_cast<Uint64>(firstTileY + i / spanX) * grid.tilesX() + firstTileX + i % spanX;
+                BlockRegion tile = grid.tile(index);
+
+                int firstCol = std::max(0, out.x - tile.x) / PIXELS_PER_BLOCK;
+                int lastCol = std::min(tile.columns(), columnCount(out.x + out.width - tile.x));
+
+                decodeColumns(file.tileBlocks(index, scratch), tile, firstCol, lastCol, file.layout(index),
+                    topPlanesMask(PLANE_COUNT), table.data(), out);
+            }
+        });
+    }
+}
+
+std::vector<std::byte> fileManagement::encodeTiled(const IndexedImage& image, int mode, int dithering, int tileSize, Compression compression) {
+    if (tileSize <= 0 || tileSize % PIXELS_PER_BLOCK != 0 || tileSize > 0xFFFF) {
+        throw std::invalid_argument("Tile size must be a multiple of 8");
+    }
+    if (image.indices.size() != static_cast<size_t>(image.width) * image.height
+        || image.palette.size() > PALETTE_COLORS) {
+        throw std::invalid_argument("Index image does not match the palette");
+    }
+
+    TileGrid grid{image.width, image.height, tileSize};
+    IndexCodes codes{image.indices, image.width};
+    // The image is in memory, so its tile count (at most one per 64 pixels)
+    // fits an int.
+    int tileCount = static_cast<int>(grid.tileCount());
+
+    // Compressed tiles are encoded into their own buffers first, their sizes
+    // are only known afterwards.
+    std::vector<std::vector<Uint8>> chunks;
+    if (compression == Compression::Lz) {
+        chunks.resize(tileCount);
+        Parallel::For(tileCount, 1, [&](int begin, int end) {
+            std::vector<Uint8> raw;
+
+            for (int i = begin; i < end; i++) {
+                BlockRegion tile = grid.tile(i);
+                raw.resize(tile.blockCount() * BYTES_PER_BLOCK);
+                encodeColumns(codes, tile, 0, tile.columns(), BlockLayout::interleaved(), raw.data());
+                if (!compressChunk(raw, chunks[i])) {
+                    chunks[i] = raw;
+                }
+            }
+        });
+    }
+
+    std::vector<Uint64> offsets(tileCount + 1);
+    offsets[0] = tableOffset() + tableSize(grid);
+    for (int i = 0; i < tileCount; i++) {
+        size_t size = chunks.empty() ? grid.tile(i).blockCount() * BYTES_PER_BLOCK : chunks[i].size();
+        offsets[i + 1] = offsets[i] + size;
+    }
+
+    std::vector<std::byte> output(offsets.back());
+    Uint8* out = reinterpret_cast<Uint8*>(output.data());
+
+    writeHeaderV2(out, grid.width, grid.height, grid.tileSize, (mode & MODE_MASK) | FLAG_INDEXED, dithering,
+        static_cast<int>(compression), LAYOUT_TILES);
+    writePalette(image.palette, out + V2_HEADER_SIZE);
+    std::memcpy(out + tableOffset(), offsets.data(), offsets.size() * sizeof(Uint64));
+
+    Parallel::For(tileCount, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (chunks.empty()) {
+                BlockRegion tile = grid.tile(i);
+                encodeColumns(codes, tile, 0, tile.columns(), BlockLayout::interleaved(), out + offsets[i]);
+            } else {
+                std::memcpy(out + offsets[i], chunks[i].data(), chunks[i].size());
+            }
+        }
+    });
+
+    return output;
+}
+
+void fileManagement::saveToFileTiled(const IndexedImage& image, std::filesystem::path path, int mode, int dithering, int tileSize, Compression compression) {
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+
+    std::vector<std::byte> encoded = encodeTiled(image, mode, dithering, tileSize, compression);
+    file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+
+    file.close();
+}
+
+fileManagement::DG5ImageData fileManagement::decodeTiled(std::span<const std::byte> data) {
+    TiledFile file(data);
+
+    return decodeRegion(data, 0, 0, file.grid.width, file.grid.height);
+}
+
+fileManagement::DG5ImageData fileManagement::decodeRegion(std::span<const std::byte> data, int x, int y, int width, int height) {
+    TiledFile file(data);
+    DG5ImageData image;
+
+    if (x < 0 || y < 0 || width < 0 || height < 0
+        || x > file.grid.width - width || y > file.grid.height - height) {
+        throw std::invalid_argument("Region is outside the image");
+    }
+
+    if (static_cast<Uint64>(width) * height > MAX_DECODED_PIXELS) {
+        throw std::invalid_argument("Region too large to decode at once");
+    }
+
+    image.width = width;
+    image.height = height;
+    image.image.resize(static_cast<size_t>(width) * height * 4);
+
+    if (width > 0 && height > 0) {
+        PixelWindow out{reinterpret_cast<Uint32*>(image.image.data()), static_cast<size_t>(width),
+            x, y, width, height};
+        decodeWindow(file, out);
+    }
+
+    return image;
+}
+
+fileManagement::DG5ImageData fileManagement::loadRegion(std::filesystem::path path, int x, int y, int width, int height) {
+    MappedFile file(path);
+
+    return decodeRegion(file.bytes(), x, y, width, height);
+}
+
+void fileManagement::detail::sampleTiled(std::span<const std::byte> data, const SampleGrid& grid) {
+    TiledFile file(data);
+    std::array<Uint32, 32> table = file.header.decodeTable(data);
+    int tileSize = file.grid.tileSize;
+
+    // Tiles holding at least one sample; the others are never read or
+    // decompressed.
+    std::vector<Uint64> tiles;
+    for (size_t j = 0; j < grid.ys.size();) {
+        Uint64 tileY = grid.ys[j] / tileSize;
+        for (size_t i = 0; i < grid.xs.size();) {
+            Uint64 tileX = grid.xs[i] / tileSize;
+            tiles.push_back(tileY * file.grid.tilesX() + tileX);
+            i = SampleGrid::within(grid.xs, 0, static_cast<int>(std::min<Uint64>((tileX + 1) * tileSize, file.grid.width))).second;
+        }
+        j = SampleGrid::within(grid.ys, 0, static_cast<int>(std::min<Uint64>((tileY + 1) * tileSize, file.grid.height))).second;
+    }
+
+    Parallel::For(static_cast<int>(tiles.size()), 1, [&](int begin, int end) {
+        std::vector<Uint8> scratch;
+
+        for (int i = begin; i < end; i++) {
+            BlockRegion tile = file.grid.tile(tiles[i]);
+            auto [firstX, lastX] = SampleGrid::within(grid.xs, tile.x, tile.x + tile.width);
+            sampleColumns(file.tileBlocks(tiles[i], scratch), tile, firstX, lastX, file.layout(tiles[i]), table.data(), grid);
+        }
+    });
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "IndexedImage.h"
+#include "fileManagement.h"
+
+namespace fileManagement {
+    // DG5 v2 container: 32-bit dimensions, a version field and the payload
+    // split into square tiles (a multiple of 8 pixels on a side, 256 by
+    // default). Every tile is stored like a small v1 payload, column strips
+    // of 5-byte blocks, and a table of file offsets locates each tile, so a
+    // region can be decoded by reading only the tiles it overlaps and
+    // independent tiles can be processed in parallel.
+    const int DEFAULT_TILE_SIZE = 256;
+
+    // Largest number of pixels decodeTiled, decodeRegion and decodeStrips
+    // produce in one call (4 GiB of RGBA). Bigger tiled images are read a
+    // region at a time.
+    const size_t MAX_DECODED_PIXELS = size_t{1} << 30;
+
+    // Optional compression of the tile payloads. Each tile is compressed on
+    // its own (byte-oriented LZ77, runs of equal bytes as offset-1 matches),
+    // so the tile offset table doubles as the chunk size table and tiles can
+    // still be decoded in parallel and at random. Tiles that don't shrink
+    // are stored raw.
+    enum class Compression {
+        None = 0,
+        Lz = 1
+    };
+
+    std::vector<std::byte> encodeTiled(const IndexedImage& image, int mode, int dithering, int tileSize = DEFAULT_TILE_SIZE, Compression compression = Compression::None);
+    void saveToFileTiled(const IndexedImage& image, std::filesystem::path path, int mode, int dithering, int tileSize = DEFAULT_TILE_SIZE, Compression compression = Compression::None);
+
+    // Decodes a whole v2 file. decode and loadFromFile call this for v2 data.
+    DG5ImageData decodeTiled(std::span<const std::byte> data);
+
+    // Decodes the rectangle [x, x + width) x [y, y + height) of a v2 file,
+    // touching only the header, the tile table and the overlapping tiles.
+    DG5ImageData decodeRegion(std::span<const std::byte> data, int x, int y, int width, int height);
+
+    // Maps the file and decodes a region; only the pages of the tiles that
+    // are needed are read from disk.
+    DG5ImageData loadRegion(std::filesystem::path path, int x, int y, int width, int height);
+}
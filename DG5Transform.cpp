@@ -0,0 +1,227 @@
+#include "DG5Transform.h"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#include "DG5Blocks.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+namespace {
+    constexpr std::array<Uint8, 256> REVERSED_BITS = [] {
+        std::array<Uint8, 256> table{};
+        for (int i = 0; i < 256; i++) {
+            int reversed = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                reversed |= ((i >> bit) & 1) << (7 - bit);
+            }
+            table[i] = static_cast<Uint8>(reversed);
+        }
+        return table;
+    }();
+
+    // A complete interleaved v1 file.
+    struct PackedImage {
+        Header header;
+        const Uint8* file;
+        BlockRegion region;
+
+        explicit PackedImage(std::span<const std::byte> data) {
+            header = parseHeader(data);
+            if (header.version != 1 || header.planar()) {
+                throw std::invalid_argument("Packed edits need an interleaved v1 DG5 file");
+            }
+
+            file = reinterpret_cast<const Uint8*>(data.data());
+            region = {0, 0, header.width, header.height};
+            if (data.size() < HEADER_SIZE + PALETTE_SIZE + region.blockCount() * BYTES_PER_BLOCK) {
+                throw std::invalid_argument("Truncated DG5 payload");
+            }
+        }
+
+        const Uint8* block(int col, int row) const {
+            return file + HEADER_SIZE + PALETTE_SIZE + region.blockIndex(col, row) * BYTES_PER_BLOCK;
+        }
+    };
+
+    // Output with the header and palette of source and the given size.
+    std::vector<std::byte> makeOutput(const PackedImage& source, int width, int height) {
+        if (width > 0xFFFF || height > 0xFFFF) {
+            throw std::invalid_argument("Image too large for a v1 DG5 file");
+        }
+
+        BlockRegion region{0, 0, width, height};
+        Uint32 payloadSize = static_cast<Uint32>(region.blockCount() * BYTES_PER_BLOCK);
+        Uint16 width16 = static_cast<Uint16>(width);
+        Uint16 height16 = static_cast<Uint16>(height);
+
+        std::vector<std::byte> output(HEADER_SIZE + PALETTE_SIZE + payloadSize);
+        Uint8* out = reinterpret_cast<Uint8*>(output.data());
+        std::memcpy(out, source.file, HEADER_SIZE + PALETTE_SIZE);
+        std::memcpy(out + 2, &width16, 2);
+        std::memcpy(out + 4, &height16, 2);
+        std::memcpy(out + 8, &payloadSize, 4);
+        return output;
+    }
+
+    Uint8* outputBlocks(std::vector<std::byte>& output) {
+        return reinterpret_cast<Uint8*>(output.data()) + HEADER_SIZE + PALETTE_SIZE;
+    }
+
+    std::vector<std::byte> flip(std::span<const std::byte> data, bool flipX, bool flipY) {
+        PackedImage source(data);
+        const BlockRegion& region = source.region;
+        std::vector<std::byte> output = makeOutput(source, region.width, region.height);
+        Uint8* blocks = outputBlocks(output);
+
+        int columns = region.columns();
+        int height = region.height;
+        // Padding bits of the last strip end up at the start of the reversed
+        // row and have to be shifted out.
+        int shift = (PIXELS_PER_BLOCK - region.width % PIXELS_PER_BLOCK) % PIXELS_PER_BLOCK;
+
+        Parallel::For(columns, minColumnsPerTask(height), [&](int begin, int end) {
+            for (int col = begin; col < end; col++) {
+                Uint8* out = blocks + region.blockIndex(col, 0) * BYTES_PER_BLOCK;
+
+                if (!flipX) {
+                    if (!flipY) {
+                        std::memcpy(out, source.block(col, 0), static_cast<size_t>(height) * BYTES_PER_BLOCK);
+                        continue;
+                    }
+                    for (int row = 0; row < height; row++, out += BYTES_PER_BLOCK) {
+                        std::memcpy(out, source.block(col, height - 1 - row), BYTES_PER_BLOCK);
+                    }
+                    continue;
+                }
+
+                int first = columns - 1 - col;
+                for (int row = 0; row < height; row++, out += BYTES_PER_BLOCK) {
+                    int sourceRow = flipY ? height - 1 - row : row;
+                    const Uint8* low = source.block(first, sourceRow);
+                    const Uint8* high = first > 0 ? source.block(first - 1, sourceRow) : nullptr;
+
+                    for (int b = 0; b < BYTES_PER_BLOCK; b++) {
+                        unsigned bits = REVERSED_BITS[low[b]] >> shift;
+                        if (high && shift) {
+                            bits |= REVERSED_BITS[high[b]] << (PIXELS_PER_BLOCK - shift);
+                        }
+                        out[b] = static_cast<Uint8>(bits);
+                    }
+                }
+            }
+        });
+
+        return output;
+    }
+}
+
+std::vector<std::byte> fileManagement::crop(std::span<const std::byte> data, int x, int y, int width, int height) {
+    PackedImage source(data);
+    const BlockRegion& region = source.region;
+
+    if (x < 0 || y < 0 || width < 0 || height < 0
+        || x > region.width - width || y > region.height - height) {
+        throw std::invalid_argument("Region is outside the image");
+    }
+    if (x % PIXELS_PER_BLOCK != 0 || (width % PIXELS_PER_BLOCK != 0 && x + width != region.width)) {
+        throw std::invalid_argument("Packed crops must be aligned to 8-pixel columns");
+    }
+
+    std::vector<std::byte> output = makeOutput(source, width, height);
+    Uint8* blocks = outputBlocks(output);
+    BlockRegion cropped{0, 0, width, height};
+    int firstColumn = x / PIXELS_PER_BLOCK;
+
+    Parallel::For(cropped.columns(), minColumnsPerTask(height), [&](int begin, int end) {
+        for (int col = begin; col < end; col++) {
+            std::memcpy(blocks + cropped.blockIndex(col, 0) * BYTES_PER_BLOCK, source.block(firstColumn + col, y),
+                static_cast<size_t>(height) * BYTES_PER_BLOCK);
+        }
+    });
+
+    return output;
+}
+
+std::vector<std::byte> fileManagement::flipVertical(std::span<const std::byte> data) {
+    return flip(data, false, true);
+}
+
+std::vector<std::byte> fileManagement::flipHorizontal(std::span<const std::byte> data) {
+    return flip(data, true, false);
+}
+
+std::vector<std::byte> fileManagement::rotate180(std::span<const std::byte> data) {
+    return flip(data, true, true);
+}
+
+std::vector<std::byte> fileManagement::mosaic(std::span<const std::span<const std::byte>> images, int columns) {
+    if (images.empty() || columns <= 0 || images.size() % columns != 0) {
+        throw std::invalid_argument("Mosaic needs whole rows of images");
+    }
+
+    std::vector<PackedImage> sources;
+    sources.reserve(images.size());
+    for (auto image: images) {
+        sources.emplace_back(image);
+    }
+
+    int rows = static_cast<int>(images.size()) / columns;
+    auto at = [&](int row, int col) -> const PackedImage& { return sources[static_cast<size_t>(row) * columns + col]; };
+
+    // Left edge (in column strips) of every grid column and top edge of
+    // every grid row.
+    std::vector<int> firstStrip(columns + 1, 0);
+    std::vector<int> firstRow(rows + 1, 0);
+    for (int col = 0; col < columns; col++) {
+        firstStrip[col + 1] = firstStrip[col] + at(0, col).region.columns();
+    }
+    for (int row = 0; row < rows; row++) {
+        firstRow[row + 1] = firstRow[row] + at(row, 0).region.height;
+    }
+
+    const PackedImage& first = sources[0];
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < columns; col++) {
+            const PackedImage& image = at(row, col);
+            if (image.region.width != at(0, col).region.width || image.region.height != at(row, 0).region.height) {
+                throw std::invalid_argument("Mosaic images don't line up");
+            }
+            if (col + 1 < columns && image.region.width % PIXELS_PER_BLOCK != 0) {
+                throw std::invalid_argument("Mosaic columns must be a multiple of 8 pixels wide");
+            }
+            if (image.header.modeByte != first.header.modeByte
+                || ((first.header.modeByte & FLAG_INDEXED)
+                    && std::memcmp(image.file + HEADER_SIZE, first.file + HEADER_SIZE, PALETTE_SIZE) != 0)) {
+                throw std::invalid_argument("Mosaic images use different palettes");
+            }
+        }
+    }
+
+    int width = 0;
+    for (int col = 0; col < columns; col++) {
+        width += at(0, col).region.width;
+    }
+    int height = firstRow[rows];
+
+    std::vector<std::byte> output = makeOutput(first, width, height);
+    Uint8* blocks = outputBlocks(output);
+    BlockRegion region{0, 0, width, height};
+
+    Parallel::For(static_cast<int>(sources.size()), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const PackedImage& image = sources[i];
+            int row = i / columns;
+            int col = i % columns;
+
+            for (int strip = 0; strip < image.region.columns(); strip++) {
+                std::memcpy(blocks + region.blockIndex(firstStrip[col] + strip, firstRow[row]) * BYTES_PER_BLOCK,
+                    image.block(strip, 0), static_cast<size_t>(image.region.height) * BYTES_PER_BLOCK);
+            }
+        }
+    });
+
+    return output;
+}
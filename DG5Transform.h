@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace fileManagement {
+    // Geometric edits of v1 DG5 data done on the packed blocks: pixels are
+    // never expanded to RGBA and the palette and mode are kept as stored.
+    // Inputs must be complete interleaved v1 files; the results are too.
+    //
+    // Column strips are 8 pixels wide, so crops must start on a multiple of
+    // 8 and end on one or at the right edge; any row range is allowed.
+    std::vector<std::byte> crop(std::span<const std::byte> data, int x, int y, int width, int height);
+
+    std::vector<std::byte> flipVertical(std::span<const std::byte> data);
+
+    // Reverses the bits of every plane byte and the order of the column
+    // strips; widths that aren't a multiple of 8 shift the bits across
+    // neighbouring strips.
+    std::vector<std::byte> flipHorizontal(std::span<const std::byte> data);
+
+    std::vector<std::byte> rotate180(std::span<const std::byte> data);
+
+    // Joins images given row by row into a grid with the given number of
+    // columns. Images in a grid row share a height, images in a grid column
+    // share a width, and every grid column but the last must be a multiple
+    // of 8 wide. All images need the same mode byte and, when indexed, the
+    // same palette.
+    std::vector<std::byte> mosaic(std::span<const std::span<const std::byte>> images, int columns);
+}
@@ -0,0 +1,98 @@
+#include "DG5View.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "DG5Blocks.h"
+#include "Parallel.h"
+
+using namespace fileManagement::detail;
+
+fileManagement::DG5View::DG5View(std::span<const std::byte> data) {
+    open(data);
+}
+
+fileManagement::DG5View::DG5View(const std::filesystem::path& path) : file(std::in_place, path) {
+    open(file->bytes());
+}
+
+void fileManagement::DG5View::open(std::span<const std::byte> data) {
+    Header header = parseHeader(data);
+    if (header.version != 1) {
+        throw std::invalid_argument("Random access needs a v1 DG5 file");
+    }
+
+    BlockRegion region{0, 0, header.width, header.height};
+    if (data.size() < HEADER_SIZE + PALETTE_SIZE + region.blockCount() * BYTES_PER_BLOCK) {
+        throw std::invalid_argument("Truncated DG5 payload");
+    }
+
+    blocks = reinterpret_cast<const Uint8*>(data.data()) + HEADER_SIZE + PALETTE_SIZE;
+    imageWidth = header.width;
+    imageHeight = header.height;
+    planar = header.planar();
+    table = header.decodeTable(data);
+}
+
+std::uint8_t fileManagement::DG5View::getIndex(int x, int y) const {
+    if (x < 0 || y < 0 || x >= imageWidth || y >= imageHeight) {
+        throw std::invalid_argument("Pixel is outside the image");
+    }
+
+    BlockRegion region{0, 0, imageWidth, imageHeight};
+    BlockLayout layout = planar ? BlockLayout::planar(region.blockCount()) : BlockLayout::interleaved();
+    Uint8 planes[BYTES_PER_BLOCK];
+    layout.load(blocks, region.blockIndex(x / PIXELS_PER_BLOCK, y), 0x1F, planes);
+
+    int bit = x % PIXELS_PER_BLOCK;
+    Uint8 code = 0;
+    for (int b = 0; b < PLANE_COUNT; b++) {
+        code |= ((planes[b] >> bit) & 1) << b;
+    }
+    return code;
+}
+
+std::uint32_t fileManagement::DG5View::getPixel(int x, int y) const {
+    return table[getIndex(x, y)];
+}
+
+void fileManagement::DG5View::getSpan(int x0, int x1, int y, std::span<std::uint32_t> out) const {
+    if (x0 < 0 || x1 < x0 || x1 > imageWidth || y < 0 || y >= imageHeight) {
+        throw std::invalid_argument("Span is outside the image");
+    }
+    if (out.size() < static_cast<size_t>(x1 - x0)) {
+        throw std::invalid_argument("Span buffer too small");
+    }
+
+    BlockRegion region{0, 0, imageWidth, imageHeight};
+    BlockLayout layout = planar ? BlockLayout::planar(region.blockCount()) : BlockLayout::interleaved();
+    PixelWindow window{out.data(), out.size(), x0, y, x1 - x0, 1};
+    decodeColumns(blocks, region, x0 / PIXELS_PER_BLOCK, columnCount(x1), layout, 0x1F, table.data(), window);
+}
+
+fileManagement::DG5ImageData fileManagement::DG5View::getRect(int x, int y, int width, int height) const {
+    if (x < 0 || y < 0 || width < 0 || height < 0
+        || x > imageWidth - width || y > imageHeight - height) {
+        throw std::invalid_argument("Region is outside the image");
+    }
+
+    DG5ImageData image;
+    image.width = width;
+    image.height = height;
+    image.image.resize(static_cast<size_t>(width) * height * 4);
+    if (width == 0 || height == 0) {
+        return image;
+    }
+
+    BlockRegion region{0, 0, imageWidth, imageHeight};
+    BlockLayout layout = planar ? BlockLayout::planar(region.blockCount()) : BlockLayout::interleaved();
+    PixelWindow window{reinterpret_cast<Uint32*>(image.image.data()), static_cast<size_t>(width), x, y, width, height};
+    int firstColumn = x / PIXELS_PER_BLOCK;
+    int lastColumn = columnCount(x + width);
+
+    Parallel::For(lastColumn - firstColumn, minColumnsPerTask(height), [&](int begin, int end) {
+        decodeColumns(blocks, region, firstColumn + begin, firstColumn + end, layout, 0x1F, table.data(), window);
+    });
+
+    return image;
+}
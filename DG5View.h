@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+#include "MappedFile.h"
+#include "fileManagement.h"
+
+namespace fileManagement {
+    // Random access to the pixels of a v1 DG5 file (either block layout)
+    // without decoding it. The block holding (x, y) is found with
+    // arithmetic, column strip x / 8 and row y, so every call decodes only
+    // the blocks it touches.
+    class DG5View {
+    public:
+        // data must outlive the view.
+        explicit DG5View(std::span<const std::byte> data);
+        // Maps the file; pages are read as pixels are accessed.
+        explicit DG5View(const std::filesystem::path& path);
+
+        int width() const { return imageWidth; }
+        int height() const { return imageHeight; }
+
+        // Code (palette index for indexed files) and RGBA colour of a pixel.
+        std::uint8_t getIndex(int x, int y) const;
+        std::uint32_t getPixel(int x, int y) const;
+
+        // Colours of [x0, x1) on row y; out must hold x1 - x0 pixels.
+        void getSpan(int x0, int x1, int y, std::span<std::uint32_t> out) const;
+
+        // Colours of [x, x + width) x [y, y + height).
+        DG5ImageData getRect(int x, int y, int width, int height) const;
+
+    private:
+        void open(std::span<const std::byte> data);
+
+        std::optional<MappedFile> file;
+        const std::uint8_t* blocks = nullptr;
+        int imageWidth = 0;
+        int imageHeight = 0;
+        bool planar = false;
+        std::array<std::uint32_t, 32> table = {};
+    };
+}
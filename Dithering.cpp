@@ -2,6 +2,9 @@
 #include "Palette.h"
 #include "Helpers.h"
 
+#include <algorithm>
+#include <array>
+
 namespace
 {
 
@@ -10,6 +13,17 @@ namespace
     return (v < 0) ? 0 : (v > 255 ? 255 : v);
   }
 
+  // Sizes result for the image; the index buffer keeps its allocation when
+  // it is already large enough.
+  void PrepareResult(IndexedImage& result,
+      int imageWidth, int imageHeight, std::span<uint32_t> palette)
+  {
+    result.indices.resize(static_cast<size_t>(imageWidth) * imageHeight);
+    result.palette.assign(palette.begin(), palette.end());
+    result.width = imageWidth;
+    result.height = imageHeight;
+  }
+
   constexpr float kBayer[] = {
     6.0f/16.0f, 14.0f/16.0f, 8.0f/16.0f, 16.0f/16.0f,
     10.0f/16.0f, 2.0f/16.0f, 12.0f/16.0f, 4.0f/16.0f,
@@ -17,124 +31,236 @@ namespace
     11.0f/16.0f, 3.0f/16.0f, 9.0f/16.0f, 1.0f/16.0f
   };
 
-  std::vector<std::byte> ApplyBayerDithering(
-      std::span<std::byte> image,
-      int imageWidth, int imageHeight,
-      std::span<uint32_t> palette)
+  // Bayer dithering of one row given as channel planes. The threshold
+  // offsets of a row repeat every 4 pixels, so the row is offset and
+  // clamped in one pass and the closest colours are then found for the
+  // whole row at once. Scratch rows are kept between rows.
+  class BayerRowDitherer
   {
-    size_t resultSize = imageWidth * imageHeight * 4;
-    std::vector<std::byte> result(resultSize);
+  public:
+    BayerRowDitherer(int width, std::span<uint32_t> palette)
+      : width(width), palette(palette), r(width), g(width), b(width), offsets(width)
+    {
+    }
 
-    uint32_t* imageData = reinterpret_cast<uint32_t*>(image.data());
-    uint32_t* resultData = reinterpret_cast<uint32_t*>(result.data());
+    void Dither(const uint8_t* rRow, const uint8_t* gRow, const uint8_t* bRow, int i, uint8_t* indices)
+    {
+      for (int j = 0; j < width; ++j) {
+        float threshold = kBayer[j % 4 + (i % 4) * 4] - 0.5f;
+        offsets[j] = static_cast<int16_t>(threshold * 31.0f);
+      }
 
-    for (int i = 0; i < imageHeight; ++i) {
-      for (int j = 0; j < imageWidth; ++j) {
-        int idx = j + i * imageWidth;
+      Helpers::ClampAdd(rRow, offsets.data(), width, r.data());
+      Helpers::ClampAdd(gRow, offsets.data(), width, g.data());
+      Helpers::ClampAdd(bRow, offsets.data(), width, b.data());
 
-        int x = j % 4, y = i % 4;
-        float threshold = kBayer[x + y * 4] - 0.5f;
+      Palette::FindClosestIndices(r.data(), g.data(), b.data(), width, palette, indices);
+    }
 
-        auto unpackedPixelColor = Helpers::UnpackColor(imageData[idx]);
+  private:
+    int width;
+    std::span<uint32_t> palette;
+    std::vector<uint8_t> r, g, b;
+    std::vector<int16_t> offsets;
+  };
 
-        uint8_t r = ClampToByte(static_cast<int>(unpackedPixelColor[0])
-            + static_cast<int>(threshold * 31.0f));
-        uint8_t g = ClampToByte(static_cast<int>(unpackedPixelColor[1])
-            + static_cast<int>(threshold * 31.0f));
-        uint8_t b = ClampToByte(static_cast<int>(unpackedPixelColor[2])
-            + static_cast<int>(threshold * 31.0f));
+  void ApplyBayerDithering(
+      const ImageView& image,
+      std::span<uint32_t> palette,
+      IndexedImage& result)
+  {
+    int imageWidth = image.width;
+    int imageHeight = image.height;
+    PrepareResult(result, imageWidth, imageHeight, palette);
 
-        uint32_t closestColor = Palette::FindClosestColorFromPalette(
-            Helpers::PackColor(r, g, b, unpackedPixelColor[3]), palette);
+    BayerRowDitherer ditherer(imageWidth, palette);
+    std::vector<uint8_t> r(imageWidth), g(imageWidth), b(imageWidth), a(imageWidth);
 
-        resultData[idx] = closestColor;
-      }
+    for (int i = 0; i < imageHeight; ++i) {
+      Helpers::UnpackColors(image.Row(i), imageWidth, r.data(), g.data(), b.data(), a.data());
+      ditherer.Dither(r.data(), g.data(), b.data(), i,
+          result.indices.data() + static_cast<size_t>(i) * imageWidth);
     }
+  }
+
+  void ApplyBayerDithering(
+      const PlanarImage& image,
+      std::span<uint32_t> palette,
+      IndexedImage& result)
+  {
+    int imageWidth = image.width;
+    int imageHeight = image.height;
+    PrepareResult(result, imageWidth, imageHeight, palette);
 
-    return result;
+    BayerRowDitherer ditherer(imageWidth, palette);
+
+    for (int i = 0; i < imageHeight; ++i) {
+      size_t rowStart = static_cast<size_t>(i) * imageWidth;
+      ditherer.Dither(image.r.data() + rowStart, image.g.data() + rowStart, image.b.data() + rowStart, i,
+          result.indices.data() + rowStart);
+    }
   }
 
-  std::vector<std::byte> ApplyFloydSteinbergDithering(
-      std::span<std::byte> image,
-      int imageWidth, int imageHeight,
-      std::span<uint32_t> palette)
+  void ApplyBayerDithering(
+      const CompactImage& image,
+      std::span<uint32_t> palette,
+      IndexedImage& result)
   {
-    size_t pixelCount = imageWidth * imageHeight;
-    size_t resultSize = pixelCount * 4;
-    std::vector<std::byte> result(resultSize);
+    int imageWidth = image.Width();
+    int imageHeight = image.Height();
+    PrepareResult(result, imageWidth, imageHeight, palette);
 
-    uint32_t* imageData = reinterpret_cast<uint32_t*>(image.data());
-    uint32_t* resultData = reinterpret_cast<uint32_t*>(result.data());
+    BayerRowDitherer ditherer(imageWidth, palette);
+    std::vector<uint8_t> scratch;
 
-    std::vector<float> rErrors(pixelCount, 0.0f);
-    std::vector<float> gErrors(pixelCount, 0.0f);
-    std::vector<float> bErrors(pixelCount, 0.0f);
+    for (int i = 0; i < imageHeight; ++i) {
+      CompactImage::Channels row = image.RowChannels(i, scratch);
+      ditherer.Dither(row.r, row.g, row.b, i,
+          result.indices.data() + static_cast<size_t>(i) * imageWidth);
+    }
+  }
+
+  // Pixels is called as pixels(i, j) and returns the unpacked colour of
+  // row i, column j, so interleaved and planar images share the kernel.
+  template <typename Pixels>
+  void ApplyFloydSteinbergDithering(
+      const Pixels& pixels,
+      int imageWidth, int imageHeight,
+      std::span<uint32_t> palette,
+      IndexedImage& result)
+  {
+    PrepareResult(result, imageWidth, imageHeight, palette);
+
+    // Error only spreads to the current and the next row, so two rows of
+    // accumulators are enough.
+    std::vector<float> rErrors(imageWidth, 0.0f);
+    std::vector<float> gErrors(imageWidth, 0.0f);
+    std::vector<float> bErrors(imageWidth, 0.0f);
+    std::vector<float> rNextErrors(imageWidth, 0.0f);
+    std::vector<float> gNextErrors(imageWidth, 0.0f);
+    std::vector<float> bNextErrors(imageWidth, 0.0f);
 
     for (int i = 0; i < imageHeight; ++i) {
       for (int j = 0; j < imageWidth; ++j) {
         int idx = j + i * imageWidth;
 
-        auto unpackedPixelColor = Helpers::UnpackColor(imageData[idx]);
+        std::array<uint8_t, 4> unpackedPixelColor = pixels(i, j);
 
-        uint8_t r = ClampToByte(unpackedPixelColor[0] + rErrors[idx]);
-        uint8_t g = ClampToByte(unpackedPixelColor[1] + gErrors[idx]);
-        uint8_t b = ClampToByte(unpackedPixelColor[2] + bErrors[idx]);
+        uint8_t r = ClampToByte(unpackedPixelColor[0] + rErrors[j]);
+        uint8_t g = ClampToByte(unpackedPixelColor[1] + gErrors[j]);
+        uint8_t b = ClampToByte(unpackedPixelColor[2] + bErrors[j]);
 
-        uint32_t closestColor = Palette::FindClosestColorFromPalette(
+        uint8_t closestIndex = Palette::FindClosestIndexFromPalette(
             Helpers::PackColor(r, g, b, unpackedPixelColor[3]), palette);
 
-        resultData[idx] = closestColor;
+        result.indices[idx] = closestIndex;
 
-        auto closestColorUnpacked = Helpers::UnpackColor(closestColor);
+        auto closestColorUnpacked = Helpers::UnpackColor(palette[closestIndex]);
 
         int rError = r - closestColorUnpacked[0];
         int gError = g - closestColorUnpacked[1];
         int bError = b - closestColorUnpacked[2];
 
         if (j + 1 < imageWidth) {
-          size_t s = j + 1 + i * imageWidth;
-          rErrors[s] += rError * 7 / 16.0f;
-          gErrors[s] += gError * 7 / 16.0f;
-          bErrors[s] += bError * 7 / 16.0f;
+          rErrors[j + 1] += rError * 7 / 16.0f;
+          gErrors[j + 1] += gError * 7 / 16.0f;
+          bErrors[j + 1] += bError * 7 / 16.0f;
         }
 
         if (j > 0 && i + 1 < imageHeight) {
-          size_t s = j - 1 + (i + 1) * imageWidth;
-          rErrors[s] += rError * 3 / 16.0f;
-          gErrors[s] += gError * 3 / 16.0f;
-          bErrors[s] += bError * 3 / 16.0f;
+          rNextErrors[j - 1] += rError * 3 / 16.0f;
+          gNextErrors[j - 1] += gError * 3 / 16.0f;
+          bNextErrors[j - 1] += bError * 3 / 16.0f;
         }
 
         if (i + 1 < imageHeight) {
-          size_t s = j + (i + 1) * imageWidth;
-          rErrors[s] += rError * 5 / 16.0f;
-          gErrors[s] += gError * 5 / 16.0f;
-          bErrors[s] += bError * 5 / 16.0f;
+          rNextErrors[j] += rError * 5 / 16.0f;
+          gNextErrors[j] += gError * 5 / 16.0f;
+          bNextErrors[j] += bError * 5 / 16.0f;
         }
 
         if (j + 1 < imageWidth && i + 1 < imageHeight) {
-          size_t s = j + 1 + (i + 1) * imageWidth;
-          rErrors[s] += rError * 1 / 16.0f;
-          gErrors[s] += gError * 1 / 16.0f;
-          bErrors[s] += bError * 1 / 16.0f;
+          rNextErrors[j + 1] += rError * 1 / 16.0f;
+          gNextErrors[j + 1] += gError * 1 / 16.0f;
+          bNextErrors[j + 1] += bError * 1 / 16.0f;
         }
       }
-    }
 
-    return result;
+      rErrors.swap(rNextErrors);
+      gErrors.swap(gNextErrors);
+      bErrors.swap(bNextErrors);
+      std::fill(rNextErrors.begin(), rNextErrors.end(), 0.0f);
+      std::fill(gNextErrors.begin(), gNextErrors.end(), 0.0f);
+      std::fill(bNextErrors.begin(), bNextErrors.end(), 0.0f);
+    }
   }
 
 }
 
-std::vector<std::byte>
+IndexedImage
 Dithering::Apply(std::span<std::byte> image,
     int imageWidth, int imageHeight,
     std::span<uint32_t> palette,
     int mode)
+{
+  IndexedImage result;
+  Apply(image, imageWidth, imageHeight, palette, mode, result);
+
+  return result;
+}
+
+void
+Dithering::Apply(std::span<std::byte> image,
+    int imageWidth, int imageHeight,
+    std::span<uint32_t> palette,
+    int mode,
+    IndexedImage& result)
+{
+  Apply(ImageView::Packed(image, imageWidth, imageHeight), palette, mode, result);
+}
+
+void
+Dithering::Apply(const ImageView& image,
+    std::span<uint32_t> palette,
+    int mode,
+    IndexedImage& result)
+{
+  if (mode == 1) {
+    ApplyBayerDithering(image, palette, result);
+  } else if (mode == 2) {
+    auto pixels = [&](int i, int j) { return Helpers::UnpackColor(image.Row(i)[j]); };
+    ApplyFloydSteinbergDithering(pixels, image.width, image.height, palette, result);
+  }
+}
+
+void
+Dithering::Apply(const PlanarImage& image,
+    std::span<uint32_t> palette,
+    int mode,
+    IndexedImage& result)
+{
+  if (mode == 1) {
+    ApplyBayerDithering(image, palette, result);
+  } else if (mode == 2) {
+    // Error diffusion is serial along each row; only the unpacking goes away.
+    auto pixels = [&](int i, int j) {
+      size_t idx = static_cast<size_t>(i) * image.width + j;
+      return std::array<uint8_t, 4>{image.r[idx], image.g[idx], image.b[idx], image.a[idx]};
+    };
+    ApplyFloydSteinbergDithering(pixels, image.width, image.height, palette, result);
+  }
+}
+
+void
+Dithering::Apply(const CompactImage& image,
+    std::span<uint32_t> palette,
+    int mode,
+    IndexedImage& result)
 {
   if (mode == 1) {
-    return ApplyBayerDithering(image, imageWidth, imageHeight, palette);
+    ApplyBayerDithering(image, palette, result);
   } else if (mode == 2) {
-    return ApplyFloydSteinbergDithering(image, imageWidth, imageHeight, palette);
+    auto pixels = [&](int i, int j) { return image.Pixel(i, j); };
+    ApplyFloydSteinbergDithering(pixels, image.Width(), image.Height(), palette, result);
   }
 }
@@ -4,12 +4,45 @@
 #include <vector>
 #include <span>
 
+#include "IndexedImage.h"
+#include "ImageView.h"
+#include "PlanarImage.h"
+#include "CompactImage.h"
+
 namespace Dithering
 {
 
-  std::vector<std::byte> Apply(std::span<std::byte> image,
+  // Dithers the image against the palette, returning one palette index per pixel.
+  IndexedImage Apply(std::span<std::byte> image,
       int imageWidth, int imageHeight,
       std::span<std::uint32_t> palette,
       int mode);
 
+  // Same, writing into result and reusing its index buffer when the size
+  // matches, so repeated calls on one image don't allocate.
+  void Apply(std::span<std::byte> image,
+      int imageWidth, int imageHeight,
+      std::span<std::uint32_t> palette,
+      int mode,
+      IndexedImage& result);
+
+  // Same for any view, e.g. a sub-view of a larger image.
+  void Apply(const ImageView& image,
+      std::span<std::uint32_t> palette,
+      int mode,
+      IndexedImage& result);
+
+  // Same on a planar image. Bayer dithering runs a row at a time through
+  // the batched palette search and gives the same indices.
+  void Apply(const PlanarImage& image,
+      std::span<std::uint32_t> palette,
+      int mode,
+      IndexedImage& result);
+
+  // Same on a compact original.
+  void Apply(const CompactImage& image,
+      std::span<std::uint32_t> palette,
+      int mode,
+      IndexedImage& result);
+
 } //Dithering
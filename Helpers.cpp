@@ -0,0 +1,241 @@
+#include "Helpers.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HELPERS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define HELPERS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// SSE2 is part of x86-64, so unlike PixelFormat's SSSE3 paths these need no
+// runtime check. Every vector loop returns how many pixels it handled and
+// the scalar loop finishes the rest.
+
+namespace
+{
+
+#if defined(HELPERS_SSE2)
+
+  std::size_t UnpackColorsSimd(const uint32_t* colors, std::size_t count,
+      uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a)
+  {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    uint8_t* planes[4] = {r, g, b, a};
+
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+      __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i + 4));
+      __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i + 8));
+      __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i + 12));
+
+      for (int c = 0; c < 4; ++c) {
+        // Each lane holds one byte value, so the signed saturating packs
+        // are exact.
+        __m128i c0 = _mm_and_si128(_mm_srli_epi32(p0, c * 8), mask);
+        __m128i c1 = _mm_and_si128(_mm_srli_epi32(p1, c * 8), mask);
+        __m128i c2 = _mm_and_si128(_mm_srli_epi32(p2, c * 8), mask);
+        __m128i c3 = _mm_and_si128(_mm_srli_epi32(p3, c * 8), mask);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c] + i), packed);
+      }
+    }
+    return i;
+  }
+
+  std::size_t PackColorsSimd(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+      std::size_t count, uint32_t* colors)
+  {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i rs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+      __m128i gs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + i));
+      __m128i bs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      __m128i as = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+
+      __m128i rgLow = _mm_unpacklo_epi8(rs, gs);
+      __m128i rgHigh = _mm_unpackhi_epi8(rs, gs);
+      __m128i baLow = _mm_unpacklo_epi8(bs, as);
+      __m128i baHigh = _mm_unpackhi_epi8(bs, as);
+
+      __m128i* out = reinterpret_cast<__m128i*>(colors + i);
+      _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(rgLow, baLow));
+      _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rgLow, baLow));
+      _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rgHigh, baHigh));
+      _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rgHigh, baHigh));
+    }
+    return i;
+  }
+
+  std::size_t ComputeLumaSimd(const uint32_t* colors, std::size_t count, float* luma)
+  {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128 rWeight = _mm_set1_ps(0.299f);
+    const __m128 gWeight = _mm_set1_ps(0.587f);
+    const __m128 bWeight = _mm_set1_ps(0.114f);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+      __m128 rs = _mm_cvtepi32_ps(_mm_and_si128(p, mask));
+      __m128 gs = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask));
+      __m128 bs = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask));
+
+      // Separate multiplies and adds in the scalar order, no fused
+      // multiply-add, so the results match bit for bit.
+      __m128 sum = _mm_add_ps(_mm_mul_ps(rWeight, rs), _mm_mul_ps(gWeight, gs));
+      _mm_storeu_ps(luma + i, _mm_add_ps(sum, _mm_mul_ps(bWeight, bs)));
+    }
+    return i;
+  }
+
+  std::size_t ClampAddSimd(const uint8_t* values, const int16_t* deltas, std::size_t count, uint8_t* result)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+      __m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i));
+      __m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i + 8));
+
+      // Saturating adds keep huge deltas from wrapping; the unsigned pack
+      // then does the clamp.
+      __m128i low = _mm_adds_epi16(_mm_unpacklo_epi8(v, zero), d0);
+      __m128i high = _mm_adds_epi16(_mm_unpackhi_epi8(v, zero), d1);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), _mm_packus_epi16(low, high));
+    }
+    return i;
+  }
+
+#elif defined(HELPERS_NEON)
+
+  std::size_t UnpackColorsSimd(const uint32_t* colors, std::size_t count,
+      uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a)
+  {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      uint8x16x4_t rgba = vld4q_u8(reinterpret_cast<const uint8_t*>(colors + i));
+      vst1q_u8(r + i, rgba.val[0]);
+      vst1q_u8(g + i, rgba.val[1]);
+      vst1q_u8(b + i, rgba.val[2]);
+      vst1q_u8(a + i, rgba.val[3]);
+    }
+    return i;
+  }
+
+  std::size_t PackColorsSimd(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+      std::size_t count, uint32_t* colors)
+  {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      uint8x16x4_t rgba = {{vld1q_u8(r + i), vld1q_u8(g + i), vld1q_u8(b + i), vld1q_u8(a + i)}};
+      vst4q_u8(reinterpret_cast<uint8_t*>(colors + i), rgba);
+    }
+    return i;
+  }
+
+  std::size_t ComputeLumaSimd(const uint32_t* colors, std::size_t count, float* luma)
+  {
+    const uint32x4_t mask = vdupq_n_u32(0xFF);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      uint32x4_t p = vld1q_u32(colors + i);
+      float32x4_t rs = vcvtq_f32_u32(vandq_u32(p, mask));
+      float32x4_t gs = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 8), mask));
+      float32x4_t bs = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 16), mask));
+
+      float32x4_t sum = vaddq_f32(vmulq_n_f32(rs, 0.299f), vmulq_n_f32(gs, 0.587f));
+      vst1q_f32(luma + i, vaddq_f32(sum, vmulq_n_f32(bs, 0.114f)));
+    }
+    return i;
+  }
+
+  std::size_t ClampAddSimd(const uint8_t* values, const int16_t* deltas, std::size_t count, uint8_t* result)
+  {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      uint8x16_t v = vld1q_u8(values + i);
+      int16x8_t low = vqaddq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v))), vld1q_s16(deltas + i));
+      int16x8_t high = vqaddq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v))), vld1q_s16(deltas + i + 8));
+      vst1q_u8(result + i, vcombine_u8(vqmovun_s16(low), vqmovun_s16(high)));
+    }
+    return i;
+  }
+
+#else
+
+  std::size_t UnpackColorsSimd(const uint32_t*, std::size_t, uint8_t*, uint8_t*, uint8_t*, uint8_t*) { return 0; }
+  std::size_t PackColorsSimd(const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*, std::size_t, uint32_t*) { return 0; }
+  std::size_t ComputeLumaSimd(const uint32_t*, std::size_t, float*) { return 0; }
+  std::size_t ClampAddSimd(const uint8_t*, const int16_t*, std::size_t, uint8_t*) { return 0; }
+
+#endif
+
+}
+
+void Helpers::Scalar::UnpackColors(const uint32_t* colors, std::size_t count,
+    uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    auto unpacked = UnpackColor(colors[i]);
+    r[i] = unpacked[0];
+    g[i] = unpacked[1];
+    b[i] = unpacked[2];
+    a[i] = unpacked[3];
+  }
+}
+
+void Helpers::Scalar::PackColors(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+    std::size_t count, uint32_t* colors)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    colors[i] = PackColor(r[i], g[i], b[i], a[i]);
+  }
+}
+
+void Helpers::Scalar::ComputeLuma(const uint32_t* colors, std::size_t count, float* luma)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    auto unpacked = UnpackColor(colors[i]);
+    luma[i] = 0.299f * unpacked[0]
+      + 0.587f * unpacked[1]
+      + 0.114f * unpacked[2];
+  }
+}
+
+void Helpers::Scalar::ClampAdd(const uint8_t* values, const int16_t* deltas, std::size_t count, uint8_t* result)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    int v = values[i] + deltas[i];
+    result[i] = (v < 0) ? 0 : (v > 255 ? 255 : v);
+  }
+}
+
+void Helpers::UnpackColors(const uint32_t* colors, std::size_t count,
+    uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a)
+{
+  std::size_t done = UnpackColorsSimd(colors, count, r, g, b, a);
+  Scalar::UnpackColors(colors + done, count - done, r + done, g + done, b + done, a + done);
+}
+
+void Helpers::PackColors(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+    std::size_t count, uint32_t* colors)
+{
+  std::size_t done = PackColorsSimd(r, g, b, a, count, colors);
+  Scalar::PackColors(r + done, g + done, b + done, a + done, count - done, colors + done);
+}
+
+void Helpers::ComputeLuma(const uint32_t* colors, std::size_t count, float* luma)
+{
+  std::size_t done = ComputeLumaSimd(colors, count, luma);
+  Scalar::ComputeLuma(colors + done, count - done, luma + done);
+}
+
+void Helpers::ClampAdd(const uint8_t* values, const int16_t* deltas, std::size_t count, uint8_t* result)
+{
+  std::size_t done = ClampAddSimd(values, deltas, count, result);
+  Scalar::ClampAdd(values + done, deltas + done, count - done, result + done);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 
 namespace Helpers
 {
@@ -25,4 +27,40 @@ namespace Helpers
     return result;
   }
 
+  // Batched forms of the above for count pixels, with the channels as
+  // separate planes. They use SSE2 or NEON where available; the Scalar
+  // namespace holds the plain loops they are checked against.
+
+  // RGBA colours to R, G, B and A planes.
+  void UnpackColors(const std::uint32_t* colors, std::size_t count,
+      std::uint8_t* r, std::uint8_t* g, std::uint8_t* b, std::uint8_t* a);
+
+  // R, G, B and A planes to RGBA colours.
+  void PackColors(const std::uint8_t* r, const std::uint8_t* g, const std::uint8_t* b, const std::uint8_t* a,
+      std::size_t count, std::uint32_t* colors);
+
+  // 0.299 R + 0.587 G + 0.114 B of every colour, bit-identical to the
+  // scalar expression as long as neither is contracted into FMAs
+  // (CMakeLists.txt builds Helpers.cpp and Palette.cpp with
+  // -ffp-contract=off).
+  void ComputeLuma(const std::uint32_t* colors, std::size_t count, float* luma);
+
+  // values + deltas, clamped to 0..255.
+  void ClampAdd(const std::uint8_t* values, const std::int16_t* deltas, std::size_t count, std::uint8_t* result);
+
+  namespace Scalar
+  {
+
+    void UnpackColors(const std::uint32_t* colors, std::size_t count,
+        std::uint8_t* r, std::uint8_t* g, std::uint8_t* b, std::uint8_t* a);
+
+    void PackColors(const std::uint8_t* r, const std::uint8_t* g, const std::uint8_t* b, const std::uint8_t* a,
+        std::size_t count, std::uint32_t* colors);
+
+    void ComputeLuma(const std::uint32_t* colors, std::size_t count, float* luma);
+
+    void ClampAdd(const std::uint8_t* values, const std::int16_t* deltas, std::size_t count, std::uint8_t* result);
+
+  } //Scalar
+
 } //Helpers
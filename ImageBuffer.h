@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "ImageView.h"
+
+// Owning pixel buffer with explicit, move-only ownership. It either owns
+// memory it allocated itself, a std::vector it took over, or external
+// memory released through a caller-supplied deleter, so images can be
+// handed from a decoder to the pipeline without a copy. Resize keeps the
+// allocation when it is large enough, so a buffer reused across
+// images stops allocating once it has reached the image size. Its own
+// allocations start on an ImageView::kAlignment boundary.
+class ImageBuffer
+{
+public:
+  using Deleter = std::function<void(std::byte*)>;
+
+  ImageBuffer() = default;
+
+  explicit ImageBuffer(std::size_t size)
+  {
+    Resize(size);
+  }
+
+  // Takes over memory allocated elsewhere (e.g. by a C decoder); deleter
+  // runs once the buffer is released.
+  ImageBuffer(std::byte* data, std::size_t size, Deleter deleter)
+    : storage(data, std::move(deleter)), bytes(size), capacity(size)
+  {
+  }
+
+  // Takes over a vector's allocation without copying.
+  explicit ImageBuffer(std::vector<std::byte>&& vector)
+  {
+    if (vector.empty()) {
+      return;
+    }
+
+    auto* owned = new std::vector<std::byte>(std::move(vector));
+    bytes = capacity = owned->size();
+    storage = Storage(owned->data(), [owned](std::byte*) { delete owned; });
+  }
+
+  ImageBuffer(ImageBuffer&& other) noexcept
+    : storage(std::move(other.storage)),
+      bytes(std::exchange(other.bytes, 0)),
+      capacity(std::exchange(other.capacity, 0))
+  {
+  }
+
+  ImageBuffer& operator=(ImageBuffer&& other) noexcept
+  {
+    storage = std::move(other.storage);
+    bytes = std::exchange(other.bytes, 0);
+    capacity = std::exchange(other.capacity, 0);
+    return *this;
+  }
+
+  ImageBuffer(const ImageBuffer&) = delete;
+  ImageBuffer& operator=(const ImageBuffer&) = delete;
+
+  // Changes the size. The contents are kept while the size stays within
+  // the capacity and dropped when the buffer has to grow.
+  void Resize(std::size_t size)
+  {
+    Reserve(size);
+    bytes = size;
+  }
+
+  // Makes room for size bytes without changing the size; growing drops
+  // the contents like Resize.
+  void Reserve(std::size_t size)
+  {
+    if (size > capacity) {
+      constexpr std::align_val_t alignment{ImageView::kAlignment};
+      storage = Storage(new (alignment) std::byte[size], [](std::byte* p) {
+        ::operator delete[](p, alignment);
+      });
+      capacity = size;
+    }
+  }
+
+  std::byte* data() { return storage.get(); }
+  const std::byte* data() const { return storage.get(); }
+  std::size_t size() const { return bytes; }
+  bool empty() const { return bytes == 0; }
+
+  std::span<std::byte> span() { return {storage.get(), bytes}; }
+  std::span<const std::byte> span() const { return {storage.get(), bytes}; }
+
+private:
+  using Storage = std::unique_ptr<std::byte[], Deleter>;
+
+  Storage storage{nullptr, [](std::byte*) {}};
+  std::size_t bytes = 0;
+  std::size_t capacity = 0;
+};
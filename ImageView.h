@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+// Non-owning view of RGBA pixels (R in the first byte): width x height
+// pixels whose rows start stride bytes apart. Sub-views of a region share
+// the parent's memory, so tiles and regions of interest can be processed
+// in place. Buffers allocated by ImageBuffer start on a kAlignment
+// boundary; IsAligned tells kernels when every row does.
+struct ImageView
+{
+  static constexpr std::size_t kAlignment = 64;
+
+  std::byte* data = nullptr;
+  int width = 0;
+  int height = 0;
+  std::size_t stride = 0;
+
+  // View of tightly packed rows, as produced by the decoders.
+  static ImageView Packed(std::span<std::byte> pixels, int width, int height)
+  {
+    if (pixels.size() < static_cast<std::size_t>(width) * height * 4) {
+      throw std::invalid_argument("Pixel buffer smaller than the image");
+    }
+    return {pixels.data(), width, height, static_cast<std::size_t>(width) * 4};
+  }
+
+  std::uint32_t* Row(int y) const
+  {
+    return reinterpret_cast<std::uint32_t*>(data + static_cast<std::size_t>(y) * stride);
+  }
+
+  ImageView SubView(int x, int y, int subWidth, int subHeight) const
+  {
+    if (x < 0 || y < 0 || subWidth < 0 || subHeight < 0
+        || x > width - subWidth || y > height - subHeight) {
+      throw std::invalid_argument("Region is outside the image");
+    }
+    return {data + static_cast<std::size_t>(y) * stride + static_cast<std::size_t>(x) * 4, subWidth, subHeight, stride};
+  }
+
+  std::size_t PixelCount() const { return static_cast<std::size_t>(width) * height; }
+  bool IsContiguous() const { return stride == static_cast<std::size_t>(width) * 4; }
+
+  bool IsAligned() const
+  {
+    return reinterpret_cast<std::uintptr_t>(data) % kAlignment == 0 && stride % kAlignment == 0;
+  }
+};
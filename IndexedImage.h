@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Palettized image: one palette index per pixel, row-major, plus the
+// palette (packed RGBA, at most 32 colours) the indices refer to.
+struct IndexedImage
+{
+  std::vector<std::uint8_t> indices;
+  std::vector<std::uint32_t> palette;
+  int width = 0;
+  int height = 0;
+
+  bool empty() const { return indices.empty(); }
+};
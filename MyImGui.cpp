@@ -70,8 +70,10 @@ void MyImGui::Image(
   ImGui::EndChild();
 }
 
-void MyImGui::SettingsPalette(std::span<uint32_t> palette)
+bool MyImGui::SettingsPalette(std::span<uint32_t> palette)
 {
+  bool changed = false;
+
   ImGui::Text("Paleta");
   ImGui::BeginGroup();
 
@@ -85,9 +87,24 @@ void MyImGui::SettingsPalette(std::span<uint32_t> palette)
       ImGuiColorEditFlags_NoAlpha | ImGuiColorEditFlags_NoPicker;
 
     ImVec4 color = ImGui::ColorConvertU32ToFloat4(palette[i]);
-    ImGui::ColorButton("##palette", color, colorButtonFlags, ImVec2(32, 32));
-
+    bool clicked =
+      ImGui::ColorButton("##palette", color, colorButtonFlags, ImVec2(32, 32));
     float lastButtonX2 = ImGui::GetItemRectMax().x;
+
+    if (clicked) {
+      ImGui::OpenPopup("##picker");
+    }
+
+    // Edit the entry in place, the index image stays as it is
+    if (ImGui::BeginPopup("##picker")) {
+      if (ImGui::ColorPicker3("##color", &color.x, ImGuiColorEditFlags_NoAlpha)) {
+        color.w = 1.0f;
+        palette[i] = ImGui::ColorConvertFloat4ToU32(color);
+        changed = true;
+      }
+      ImGui::EndPopup();
+    }
+
     float nextButtonX2 = lastButtonX2 + ImGui::GetStyle().ItemSpacing.y + 32;
     if (nextButtonX2  < windowVisibleX2) {
       ImGui::SameLine();
@@ -96,4 +113,6 @@ void MyImGui::SettingsPalette(std::span<uint32_t> palette)
     ImGui::PopID();
   }
   ImGui::EndGroup();
+
+  return changed;
 }
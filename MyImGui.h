@@ -20,6 +20,8 @@ namespace MyImGui
       ImVec2 uv0, ImVec2 uv1,
       ImVec4 bgColor, ImVec4 tintColor);
 
-  void SettingsPalette(std::span<std::uint32_t> palette);
+  // Shows the palette swatches; clicking one opens a colour picker.
+  // Returns true when an entry was edited.
+  bool SettingsPalette(std::span<std::uint32_t> palette);
 
 } //MyImGui
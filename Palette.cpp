@@ -2,13 +2,67 @@
 #include "Helpers.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
+#include <stdexcept>
 
 namespace
 {
 
   constexpr int kColorCount = 32;
 
+  void CopyPixels(const ImageView& image, std::vector<uint32_t>& pixels)
+  {
+    pixels.resize(image.PixelCount());
+    for (int i = 0; i < image.height; ++i) {
+      const uint32_t* row = image.Row(i);
+      std::copy(row, row + image.width, pixels.begin() + static_cast<size_t>(i) * image.width);
+    }
+  }
+
+  // Expanded to opaque RGBA; median cut sorts whole colours.
+  void CopyPixels(const CompactImage& image, std::vector<uint32_t>& pixels)
+  {
+    pixels.resize(image.PixelCount());
+    std::vector<uint8_t> scratch;
+
+    for (int i = 0; i < image.Height(); ++i) {
+      CompactImage::Channels row = image.RowChannels(i, scratch);
+      uint32_t* destination = pixels.data() + static_cast<size_t>(i) * image.Width();
+
+      for (int j = 0; j < image.Width(); ++j) {
+        destination[j] = Helpers::PackColor(row.r[j], row.g[j], row.b[j], 255);
+      }
+    }
+  }
+
+  void ComputeLuminance(const ImageView& image, std::vector<float>& luminance)
+  {
+    luminance.resize(image.PixelCount());
+    for (int i = 0; i < image.height; ++i) {
+      Helpers::ComputeLuma(image.Row(i), image.width, luminance.data() + static_cast<size_t>(i) * image.width);
+    }
+  }
+
+  // Same expression as Helpers::ComputeLuma, so both storages give the
+  // same palette.
+  void ComputeLuminance(const CompactImage& image, std::vector<float>& luminance)
+  {
+    luminance.resize(image.PixelCount());
+    std::vector<uint8_t> scratch;
+
+    for (int i = 0; i < image.Height(); ++i) {
+      CompactImage::Channels row = image.RowChannels(i, scratch);
+      float* destination = luminance.data() + static_cast<size_t>(i) * image.Width();
+
+      for (int j = 0; j < image.Width(); ++j) {
+        destination[j] = 0.299f * row.r[j]
+          + 0.587f * row.g[j]
+          + 0.114f * row.b[j];
+      }
+    }
+  }
+
   std::vector<uint32_t> GeneratePosterized()
   {
     std::vector<uint32_t> result(kColorCount);
@@ -35,12 +89,13 @@ namespace
     return result;
   } 
 
-  std::vector<uint32_t> GenerateMedianCut(
-      std::span<std::byte> image, int imageWidth, int imageHeight)
+  // imageDataCopy is sorted in place; callers that keep it between calls
+  // don't allocate when regenerating the palette of the same image.
+  template <typename Image>
+  std::vector<uint32_t> GenerateMedianCut(const Image& image, std::vector<uint32_t>& imageDataCopy)
   {
-    size_t pixelCount = imageWidth * imageHeight;
-    uint32_t* imageData = reinterpret_cast<uint32_t*>(image.data());
-    std::vector<uint32_t> imageDataCopy(imageData, imageData + pixelCount);
+    size_t pixelCount = image.PixelCount();
+    CopyPixels(image, imageDataCopy);
 
     std::vector<uint32_t> result;
     result.reserve(kColorCount);
@@ -124,24 +179,19 @@ namespace
     return result;
   } 
 
-  std::vector<uint32_t> GenerateMedianCutMono(
-      std::span<std::byte> image, int imageWidth, int imageHeight)
+  template <typename Image>
+  std::vector<uint32_t> GenerateMedianCutMono(const Image& image, std::vector<float>& luminance)
   {
-    size_t pixelCount = imageWidth * imageHeight;
-    uint32_t* imageData = reinterpret_cast<uint32_t*>(image.data());
-    std::vector<uint32_t> imageDataCopy(imageData, imageData + pixelCount);
+    size_t pixelCount = image.PixelCount();
+    // Only the luminance of a pixel matters here, so it is computed once per
+    // pixel and the values themselves are sorted. Pixels of equal luminance
+    // are interchangeable, which keeps the result the same as sorting the
+    // colours.
+    ComputeLuminance(image, luminance);
 
     std::vector<uint32_t> result;
     result.reserve(kColorCount);
 
-    auto Luminance = [](uint32_t color) {
-      auto colorUnpacked = Helpers::UnpackColor(color);
-
-      return 0.299f * colorUnpacked[0]
-        + 0.587f * colorUnpacked[1]
-        + 0.114f * colorUnpacked[2];
-    };
-
     std::function<void(int, int, int)> MedianCut;
     MedianCut = [&](int start, int end, int depth) {
       if (depth == 0 || end - start <= 1) {
@@ -149,7 +199,7 @@ namespace
         int count = end - start;
 
         for (int i = start; i < end; ++i) {
-          sum += Luminance(imageDataCopy[i]);
+          sum += luminance[i];
         }
 
         uint8_t l = static_cast<uint8_t>(sum / count);
@@ -158,10 +208,7 @@ namespace
         return;
       }
 
-      std::sort(imageDataCopy.begin() + start, imageDataCopy.begin() + end,
-          [&](uint32_t a, uint32_t b) {
-          return Luminance(a) < Luminance(b);
-          });
+      std::sort(luminance.begin() + start, luminance.begin() + end);
 
       int mid = (start + end) / 2;
 
@@ -183,6 +230,12 @@ namespace
 
 uint32_t Palette::FindClosestColorFromPalette(
     uint32_t color, std::span<const uint32_t> palette)
+{
+  return palette[FindClosestIndexFromPalette(color, palette)];
+}
+
+uint8_t Palette::FindClosestIndexFromPalette(
+    uint32_t color, std::span<const uint32_t> palette)
 {
   auto ColorDistanceSq = [](uint32_t a, uint32_t b) {
     auto unpackedA = Helpers::UnpackColor(a);
@@ -195,25 +248,112 @@ uint32_t Palette::FindClosestColorFromPalette(
     return dr*dr + dg*dg + db*db;
   };
 
-  uint32_t closestColor = palette[0];
-  int closestColorDist = ColorDistanceSq(color, closestColor);
-  for (uint32_t paletteColor : palette) {
-    int colorDist = ColorDistanceSq(color, paletteColor);
+  uint8_t closestIndex = 0;
+  int closestColorDist = ColorDistanceSq(color, palette[0]);
+  for (size_t i = 1; i < palette.size(); ++i) {
+    int colorDist = ColorDistanceSq(color, palette[i]);
     if (colorDist < closestColorDist) {
-      closestColor = paletteColor;
+      closestIndex = static_cast<uint8_t>(i);
       closestColorDist = colorDist; 
     }
   };
 
-  return closestColor;
+  return closestIndex;
+}
+
+void Palette::FindClosestIndices(const uint8_t* r, const uint8_t* g, const uint8_t* b,
+    size_t count, std::span<const uint32_t> palette, uint8_t* indices)
+{
+  constexpr size_t kBatch = 64;
+
+  for (size_t start = 0; start < count; start += kBatch) {
+    size_t n = std::min(kBatch, count - start);
+    int32_t best[kBatch];
+    uint8_t bestIndex[kBatch];
+
+    for (size_t k = 0; k < n; ++k) {
+      best[k] = INT32_MAX;
+      bestIndex[k] = 0;
+    }
+
+    // Strictly closer entries win, so ties keep the lowest index like the
+    // per-pixel search.
+    for (size_t i = 0; i < palette.size(); ++i) {
+      auto unpacked = Helpers::UnpackColor(palette[i]);
+      int32_t pr = unpacked[0], pg = unpacked[1], pb = unpacked[2];
+      uint8_t index = static_cast<uint8_t>(i);
+
+      for (size_t k = 0; k < n; ++k) {
+        int32_t dr = r[start + k] - pr;
+        int32_t dg = g[start + k] - pg;
+        int32_t db = b[start + k] - pb;
+        int32_t distance = dr*dr + dg*dg + db*db;
+        bool closer = distance < best[k];
+        best[k] = closer ? distance : best[k];
+        bestIndex[k] = closer ? index : bestIndex[k];
+      }
+    }
+
+    std::copy(bestIndex, bestIndex + n, indices + start);
+  }
+}
+
+std::vector<std::byte> Palette::Expand(
+    std::span<const uint8_t> indices, std::span<const uint32_t> palette)
+{
+  std::vector<std::byte> result(indices.size() * 4);
+  uint32_t* resultData = reinterpret_cast<uint32_t*>(result.data());
+
+  for (size_t i = 0; i < indices.size(); ++i) {
+    resultData[i] = palette[indices[i]];
+  }
+
+  return result;
+}
+
+void Palette::Expand(const IndexedImage& image, std::byte* output, int pitch)
+{
+  for (int i = 0; i < image.height; ++i) {
+    const uint8_t* indexRow = image.indices.data() + static_cast<size_t>(i) * image.width;
+    uint32_t* outputRow = reinterpret_cast<uint32_t*>(output + static_cast<size_t>(i) * pitch);
+
+    for (int j = 0; j < image.width; ++j) {
+      outputRow[j] = image.palette[indexRow[j]];
+    }
+  }
 }
 
 std::vector<uint32_t> Palette::Generate(
     std::span<std::byte> image, int imageWidth, int imageHeight, int mode)
 {
+  return Generate(ImageView::Packed(image, imageWidth, imageHeight), mode);
+}
+
+std::vector<uint32_t> Palette::Generate(const ImageView& image, int mode)
+{
+  Scratch scratch;
+
   if (mode == 0) return GeneratePosterized();
   else if (mode == 1) return GeneratePosterizedMono();
-  else if (mode == 2) return GenerateMedianCut(image, imageWidth, imageHeight);
-  else if (mode == 3) return GenerateMedianCutMono(image, imageWidth, imageHeight);
+  else if (mode == 2) return GenerateMedianCut(image, scratch.colors);
+  else if (mode == 3) return GenerateMedianCutMono(image, scratch.luminance);
+  throw std::invalid_argument("Unknown palette mode");
 }
 
+std::vector<uint32_t> Palette::Generate(const CompactImage& image, int mode)
+{
+  Scratch scratch;
+  return Generate(image, mode, scratch);
+}
+
+std::vector<uint32_t> Palette::Generate(const CompactImage& image, int mode, Scratch& scratch)
+{
+  if (mode != 2) std::vector<uint32_t>().swap(scratch.colors);
+  if (mode != 3) std::vector<float>().swap(scratch.luminance);
+
+  if (mode == 0) return GeneratePosterized();
+  else if (mode == 1) return GeneratePosterizedMono();
+  else if (mode == 2) return GenerateMedianCut(image, scratch.colors);
+  else if (mode == 3) return GenerateMedianCutMono(image, scratch.luminance);
+  throw std::invalid_argument("Unknown palette mode");
+}
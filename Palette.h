@@ -4,11 +4,53 @@
 #include <span>
 #include <vector>
 
+#include "IndexedImage.h"
+#include "ImageView.h"
+#include "CompactImage.h"
+
 namespace Palette
 {
   std::uint32_t FindClosestColorFromPalette(std::uint32_t color, std::span<const std::uint32_t> palette);
 
+  std::uint8_t FindClosestIndexFromPalette(std::uint32_t color, std::span<const std::uint32_t> palette);
+
+  // FindClosestIndexFromPalette for count pixels given as separate channel
+  // planes. Distances are computed for a batch of pixels against one
+  // palette entry at a time, which vectorizes; the results are identical.
+  void FindClosestIndices(const std::uint8_t* r, const std::uint8_t* g, const std::uint8_t* b,
+      std::size_t count, std::span<const std::uint32_t> palette, std::uint8_t* indices);
+
+  // Expands an index image back to RGBA through the palette.
+  std::vector<std::byte> Expand(std::span<const std::uint8_t> indices, std::span<const std::uint32_t> palette);
+
+  // Expands into caller memory whose rows are pitch bytes apart (e.g. a locked texture).
+  void Expand(const IndexedImage& image, std::byte* output, int pitch);
+
   std::vector<std::uint32_t> Generate(std::span<std::byte> image, int imageWidth, int imageHeight, int mode);
 
+  std::vector<std::uint32_t> Generate(const ImageView& image, int mode);
+
+  std::vector<std::uint32_t> Generate(const CompactImage& image, int mode);
+
+  // Sort buffers of the median-cut modes, owned by the caller so repeated
+  // generation for one image doesn't allocate: 4 bytes per pixel for the
+  // mode in use. Release it when the image is closed.
+  struct Scratch
+  {
+    std::vector<std::uint32_t> colors;
+    std::vector<float> luminance;
+
+    // Frees the memory; clear() would keep the capacity.
+    void Release()
+    {
+      std::vector<std::uint32_t>().swap(colors);
+      std::vector<float>().swap(luminance);
+    }
+  };
+
+  // Generate with the scratch kept between calls. Only the buffer of the
+  // current mode is held; the other is released.
+  std::vector<std::uint32_t> Generate(const CompactImage& image, int mode, Scratch& scratch);
+
 } //Palette
 
@@ -0,0 +1,155 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+  struct Batch
+  {
+    int pending = 0;
+  };
+
+  struct Task
+  {
+    std::function<void()> run;
+    Batch* batch;
+  };
+
+  class Pool
+  {
+  public:
+    Pool()
+    {
+      int threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+      for (int i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this](std::stop_token stop) { WorkerLoop(stop); });
+      }
+    }
+
+    ~Pool()
+    {
+      for (auto& worker : workers) {
+        worker.request_stop();
+      }
+      wakeUp.notify_all();
+    }
+
+    int Size() const
+    {
+      return static_cast<int>(workers.size()) + 1;
+    }
+
+    void Run(std::vector<std::function<void()>>& jobs)
+    {
+      Batch batch;
+      {
+        std::lock_guard lock(mutex);
+        batch.pending = static_cast<int>(jobs.size());
+        for (auto& job : jobs) {
+          tasks.push_back({std::move(job), &batch});
+        }
+      }
+      wakeUp.notify_all();
+
+      std::unique_lock lock(mutex);
+      while (batch.pending > 0) {
+        if (!tasks.empty()) {
+          RunOne(lock);
+        } else {
+          done.wait(lock);
+        }
+      }
+    }
+
+  private:
+    void WorkerLoop(std::stop_token stop)
+    {
+      std::unique_lock lock(mutex);
+      while (true) {
+        wakeUp.wait(lock, stop, [this] { return !tasks.empty(); });
+        if (stop.stop_requested()) {
+          return;
+        }
+        RunOne(lock);
+      }
+    }
+
+    void RunOne(std::unique_lock<std::mutex>& lock)
+    {
+      Task task = std::move(tasks.front());
+      tasks.pop_front();
+
+      lock.unlock();
+      task.run();
+      lock.lock();
+
+      if (--task.batch->pending == 0) {
+        done.notify_all();
+      }
+    }
+
+    std::mutex mutex;
+    std::condition_variable_any wakeUp;
+    std::condition_variable done;
+    std::deque<Task> tasks;
+    std::vector<std::jthread> workers;
+  };
+
+  Pool& SharedPool()
+  {
+    static Pool pool;
+    return pool;
+  }
+
+}
+
+int Parallel::WorkerCount()
+{
+  return SharedPool().Size();
+}
+
+void Parallel::For(int count, int minRange, const std::function<void(int, int)>& body)
+{
+  if (count <= 0) {
+    return;
+  }
+
+  int rangeCount = std::min(WorkerCount(), count / std::max(1, minRange));
+  if (rangeCount <= 1) {
+    body(0, count);
+    return;
+  }
+
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  std::vector<std::function<void()>> jobs;
+  jobs.reserve(rangeCount);
+  for (int i = 0; i < rangeCount; ++i) {
+    int begin = static_cast<int>(static_cast<long long>(count) * i / rangeCount);
+    int end = static_cast<int>(static_cast<long long>(count) * (i + 1) / rangeCount);
+    jobs.push_back([&, begin, end] {
+      try {
+        body(begin, end);
+      } catch (...) {
+        std::lock_guard lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    });
+  }
+
+  SharedPool().Run(jobs);
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
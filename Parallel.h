@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+
+namespace Parallel
+{
+
+  // Number of threads For spreads work over (the caller included).
+  int WorkerCount();
+
+  // Splits [0, count) into contiguous ranges of at least minRange items and
+  // runs body(begin, end) for each of them on a shared pool of worker
+  // threads. The calling thread helps out and returns once every range is
+  // done, so For may be nested inside a body. The first exception thrown by
+  // a body is rethrown to the caller once all ranges have finished.
+  void For(int count, int minRange, const std::function<void(int, int)>& body);
+
+} //Parallel
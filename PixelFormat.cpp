@@ -0,0 +1,154 @@
+#include "PixelFormat.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXELFORMAT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON)
+#define PIXELFORMAT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC accepts any intrinsic; GCC and Clang need the functions using SSSE3
+// marked so the rest of the file still runs on plain x86-64.
+#if defined(PIXELFORMAT_X86) && !defined(_MSC_VER)
+#define PIXELFORMAT_SSSE3 __attribute__((target("ssse3")))
+#else
+#define PIXELFORMAT_SSSE3
+#endif
+
+namespace
+{
+
+  void BGR24ToRGBA32Scalar(const std::uint8_t* source, std::uint8_t* destination, std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; ++i, source += 3, destination += 4) {
+      destination[0] = source[2];
+      destination[1] = source[1];
+      destination[2] = source[0];
+      destination[3] = 0xFF;
+    }
+  }
+
+  void BGRA32ToRGBA32Scalar(const std::uint8_t* source, std::uint8_t* destination, std::size_t count, bool opaque)
+  {
+    for (std::size_t i = 0; i < count; ++i, source += 4, destination += 4) {
+      destination[0] = source[2];
+      destination[1] = source[1];
+      destination[2] = source[0];
+      destination[3] = opaque ? 0xFF : source[3];
+    }
+  }
+
+#ifdef PIXELFORMAT_X86
+
+  bool HasSsse3()
+  {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+  }
+
+  const bool kHasSsse3 = HasSsse3();
+
+  // Returns the number of pixels converted; the caller finishes the tail.
+  PIXELFORMAT_SSSE3 std::size_t BGR24ToRGBA32Ssse3(const std::uint8_t* source, std::uint8_t* destination, std::size_t count)
+  {
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+    // Every 16-byte load covers 4 pixels plus 4 bytes of the next ones, so
+    // stop while a full load still fits.
+    std::size_t i = 0;
+    for (; i + 6 <= count; i += 4) {
+      __m128i bgr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+      __m128i rgba = _mm_or_si128(_mm_shuffle_epi8(bgr, shuffle), alpha);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), rgba);
+    }
+    return i;
+  }
+
+  PIXELFORMAT_SSSE3 std::size_t BGRA32ToRGBA32Ssse3(const std::uint8_t* source, std::uint8_t* destination, std::size_t count, bool opaque)
+  {
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m128i alpha = _mm_set1_epi32(opaque ? static_cast<int>(0xFF000000u) : 0);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128i bgra = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+      __m128i rgba = _mm_or_si128(_mm_shuffle_epi8(bgra, shuffle), alpha);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), rgba);
+    }
+    return i;
+  }
+
+#endif
+
+}
+
+namespace PixelFormat
+{
+
+  void BGR24ToRGBA32(const std::uint8_t* source, std::uint8_t* destination, std::size_t count)
+  {
+    std::size_t done = 0;
+
+#if defined(PIXELFORMAT_X86)
+    if (kHasSsse3) {
+      done = BGR24ToRGBA32Ssse3(source, destination, count);
+    }
+#elif defined(PIXELFORMAT_NEON)
+    for (; done + 16 <= count; done += 16) {
+      uint8x16x3_t bgr = vld3q_u8(source + done * 3);
+      uint8x16x4_t rgba = {{bgr.val[2], bgr.val[1], bgr.val[0], vdupq_n_u8(0xFF)}};
+      vst4q_u8(destination + done * 4, rgba);
+    }
+#endif
+
+    BGR24ToRGBA32Scalar(source + done * 3, destination + done * 4, count - done);
+  }
+
+  void BGRA32ToRGBA32(const std::uint8_t* source, std::uint8_t* destination, std::size_t count, bool opaque)
+  {
+    std::size_t done = 0;
+
+#if defined(PIXELFORMAT_X86)
+    if (kHasSsse3) {
+      done = BGRA32ToRGBA32Ssse3(source, destination, count, opaque);
+    }
+#elif defined(PIXELFORMAT_NEON)
+    for (; done + 16 <= count; done += 16) {
+      uint8x16x4_t bgra = vld4q_u8(source + done * 4);
+      uint8x16x4_t rgba = {{bgra.val[2], bgra.val[1], bgra.val[0], opaque ? vdupq_n_u8(0xFF) : bgra.val[3]}};
+      vst4q_u8(destination + done * 4, rgba);
+    }
+#endif
+
+    BGRA32ToRGBA32Scalar(source + done * 4, destination + done * 4, count - done, opaque);
+  }
+
+  void Indexed8ToRGBA32(const std::uint8_t* source, const std::uint32_t* palette, std::uint8_t* destination, std::size_t count)
+  {
+    // A table lookup per pixel; shuffles don't help with 256 entries, so
+    // this is plain unrolled loads and 32-bit stores.
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      std::uint32_t colors[4] = {
+        palette[source[i]], palette[source[i + 1]], palette[source[i + 2]], palette[source[i + 3]]
+      };
+      std::memcpy(destination + i * 4, colors, sizeof(colors));
+    }
+    for (; i < count; ++i) {
+      std::memcpy(destination + i * 4, &palette[source[i]], 4);
+    }
+  }
+
+} //PixelFormat
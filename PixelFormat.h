@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Conversions of pixel rows from file formats to the pipeline's RGBA32
+// layout (R in the first byte). The byte swizzles use SSSE3 (pshufb) or NEON
+// when the CPU has them and a scalar loop otherwise.
+namespace PixelFormat
+{
+
+  // B, G, R triples to opaque RGBA.
+  void BGR24ToRGBA32(const std::uint8_t* source, std::uint8_t* destination, std::size_t count);
+
+  // B, G, R, A quads to RGBA. With opaque set the fourth byte is ignored
+  // and alpha is written as 255 (BMP's BI_RGB "reserved" byte).
+  void BGRA32ToRGBA32(const std::uint8_t* source, std::uint8_t* destination, std::size_t count, bool opaque);
+
+  // 8-bit indices through a 256-entry RGBA palette.
+  void Indexed8ToRGBA32(const std::uint8_t* source, const std::uint32_t* palette, std::uint8_t* destination, std::size_t count);
+
+} //PixelFormat
@@ -0,0 +1,56 @@
+#include "Planar.h"
+
+#include <stdexcept>
+
+#include "Helpers.h"
+
+void Planar::Split(const ImageView& image, PlanarImage& planar)
+{
+  planar.Resize(image.width, image.height);
+
+  for (int i = 0; i < image.height; ++i) {
+    size_t offset = static_cast<size_t>(i) * image.width;
+
+    Helpers::UnpackColors(image.Row(i), image.width, planar.r.data() + offset, planar.g.data() + offset,
+        planar.b.data() + offset, planar.a.data() + offset);
+  }
+}
+
+void Planar::Merge(const PlanarImage& planar, const ImageView& image)
+{
+  if (planar.width != image.width || planar.height != image.height) {
+    throw std::invalid_argument("Planar image and view differ in size");
+  }
+
+  for (int i = 0; i < image.height; ++i) {
+    size_t offset = static_cast<size_t>(i) * image.width;
+
+    Helpers::PackColors(planar.r.data() + offset, planar.g.data() + offset, planar.b.data() + offset,
+        planar.a.data() + offset, image.width, image.Row(i));
+  }
+}
+
+std::array<uint32_t, 256> Planar::Histogram(std::span<const uint8_t> plane)
+{
+  // Four partial histograms so consecutive equal bytes don't serialize on
+  // the same counter.
+  std::array<std::array<uint32_t, 256>, 4> partial = {};
+
+  size_t i = 0;
+  for (; i + 4 <= plane.size(); i += 4) {
+    ++partial[0][plane[i]];
+    ++partial[1][plane[i + 1]];
+    ++partial[2][plane[i + 2]];
+    ++partial[3][plane[i + 3]];
+  }
+  for (; i < plane.size(); ++i) {
+    ++partial[0][plane[i]];
+  }
+
+  std::array<uint32_t, 256> result = {};
+  for (int value = 0; value < 256; ++value) {
+    result[value] = partial[0][value] + partial[1][value] + partial[2][value] + partial[3][value];
+  }
+
+  return result;
+}
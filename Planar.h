@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "ImageView.h"
+#include "PlanarImage.h"
+
+// Batched conversions between interleaved RGBA views and planar images.
+namespace Planar
+{
+
+  // Splits the view into planes, resizing planar to the view's size.
+  void Split(const ImageView& image, PlanarImage& planar);
+
+  // Interleaves the planes into a view of the same size.
+  void Merge(const PlanarImage& planar, const ImageView& image);
+
+  // Number of occurrences of every byte value in a plane.
+  std::array<std::uint32_t, 256> Histogram(std::span<const std::uint8_t> plane);
+
+} //Planar
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Structure-of-arrays image: one byte plane per channel, row-major with no
+// padding. Kernels that read whole planes get unit-stride byte loads the
+// compiler can vectorize, where interleaved RGBA needs a per-pixel unpack.
+struct PlanarImage
+{
+  std::vector<std::uint8_t> r;
+  std::vector<std::uint8_t> g;
+  std::vector<std::uint8_t> b;
+  std::vector<std::uint8_t> a;
+  int width = 0;
+  int height = 0;
+
+  std::size_t PixelCount() const { return static_cast<std::size_t>(width) * height; }
+
+  // Keeps the plane allocations when they are large enough.
+  void Resize(int newWidth, int newHeight)
+  {
+    width = newWidth;
+    height = newHeight;
+    r.resize(PixelCount());
+    g.resize(PixelCount());
+    b.resize(PixelCount());
+    a.resize(PixelCount());
+  }
+};
@@ -1,29 +1,84 @@
 #include "Quantization.h"
 #include "Palette.h"
+#include "Helpers.h"
 
 #include <array>
 
-std::vector<std::byte>
+IndexedImage
 Quantization::Apply(std::span<std::byte> image,
     int imageWidth, int imageHeight,
     std::span<uint32_t> palette)
 {
-  size_t resultSize = imageWidth * imageHeight * 4;
-  std::vector<std::byte> result(resultSize);
+  IndexedImage result;
+  Apply(image, imageWidth, imageHeight, palette, result);
 
-  uint32_t* imageData = reinterpret_cast<uint32_t*>(image.data());
-  uint32_t* resultData = reinterpret_cast<uint32_t*>(result.data());
+  return result;
+}
 
-  for (int i = 0; i < imageHeight; ++i) {
-    for (int j = 0; j < imageWidth; ++j) {
-      int idx = j + i * imageWidth;
+void
+Quantization::Apply(std::span<std::byte> image,
+    int imageWidth, int imageHeight,
+    std::span<uint32_t> palette,
+    IndexedImage& result)
+{
+  Apply(ImageView::Packed(image, imageWidth, imageHeight), palette, result);
+}
 
-      uint32_t closestColor = Palette::FindClosestColorFromPalette(
-          imageData[idx], palette);
+void
+Quantization::Apply(const ImageView& image,
+    std::span<uint32_t> palette,
+    IndexedImage& result)
+{
+  result.indices.resize(image.PixelCount());
+  result.palette.assign(palette.begin(), palette.end());
+  result.width = image.width;
+  result.height = image.height;
+
+  // Rows are unpacked to planes so the palette search runs batched.
+  std::vector<uint8_t> r(image.width), g(image.width), b(image.width), a(image.width);
+
+  for (int i = 0; i < image.height; ++i) {
+    uint8_t* indexRow = result.indices.data() + static_cast<size_t>(i) * image.width;
 
-      resultData[idx] = closestColor;
-    }
+    Helpers::UnpackColors(image.Row(i), image.width, r.data(), g.data(), b.data(), a.data());
+    Palette::FindClosestIndices(r.data(), g.data(), b.data(), image.width, palette, indexRow);
   }
+}
 
-  return result;
+void
+Quantization::Apply(const PlanarImage& image,
+    std::span<uint32_t> palette,
+    IndexedImage& result)
+{
+  result.indices.resize(image.PixelCount());
+  result.palette.assign(palette.begin(), palette.end());
+  result.width = image.width;
+  result.height = image.height;
+
+  for (int i = 0; i < image.height; ++i) {
+    size_t rowStart = static_cast<size_t>(i) * image.width;
+
+    Palette::FindClosestIndices(image.r.data() + rowStart, image.g.data() + rowStart,
+        image.b.data() + rowStart, image.width, palette, result.indices.data() + rowStart);
+  }
+}
+
+void
+Quantization::Apply(const CompactImage& image,
+    std::span<uint32_t> palette,
+    IndexedImage& result)
+{
+  result.indices.resize(image.PixelCount());
+  result.palette.assign(palette.begin(), palette.end());
+  result.width = image.Width();
+  result.height = image.Height();
+
+  std::vector<uint8_t> scratch;
+
+  for (int i = 0; i < image.Height(); ++i) {
+    CompactImage::Channels row = image.RowChannels(i, scratch);
+
+    Palette::FindClosestIndices(row.r, row.g, row.b, image.Width(), palette,
+        result.indices.data() + static_cast<size_t>(i) * image.Width());
+  }
 }
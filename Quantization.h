@@ -2,13 +2,42 @@
 
 #include <cstdint>
 #include <span>
+
+#include "IndexedImage.h"
+#include "ImageView.h"
+#include "PlanarImage.h"
+#include "CompactImage.h"
 #include <vector>
 
 namespace Quantization
 {
 
-  std::vector<std::byte> Apply(std::span<std::byte> image,
+  // Maps every pixel to the index of its closest palette colour.
+  IndexedImage Apply(std::span<std::byte> image,
       int imageWidth, int imageHeight,
       std::span<std::uint32_t> palette);
 
+  // Same, writing into result and reusing its index buffer when the size
+  // matches, so repeated calls on one image don't allocate.
+  void Apply(std::span<std::byte> image,
+      int imageWidth, int imageHeight,
+      std::span<std::uint32_t> palette,
+      IndexedImage& result);
+
+  // Same for any view, e.g. a sub-view of a larger image.
+  void Apply(const ImageView& image,
+      std::span<std::uint32_t> palette,
+      IndexedImage& result);
+
+  // Same on a planar image, a row at a time through the batched palette
+  // search.
+  void Apply(const PlanarImage& image,
+      std::span<std::uint32_t> palette,
+      IndexedImage& result);
+
+  // Same on a compact original; grey images search one plane as R, G and B.
+  void Apply(const CompactImage& image,
+      std::span<std::uint32_t> palette,
+      IndexedImage& result);
+
 } //Quantization
@@ -0,0 +1,122 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+
+#include "DG5Analysis.h"
+#include "DG5Catalog.h"
+#include "MappedFile.h"
+
+// Command line checks on DG5 files that work on the packed blocks, for
+// regression runs over many files:
+//   dg5tool diff a.dg5 b.dg5   differing pixels and their bounding box
+//   dg5tool equal a.dg5 b.dg5  exit code 0 when the images are identical
+//   dg5tool hist a.dg5         pixel count of every palette index
+//   dg5tool catalog dir index  probe every .dg5 file of dir into an index
+//   dg5tool list index         print a catalog without opening the files
+
+namespace
+{
+
+  int Usage()
+  {
+    std::fprintf(stderr,
+      "usage: dg5tool diff <a.dg5> <b.dg5>\n"
+      "       dg5tool equal <a.dg5> <b.dg5>\n"
+      "       dg5tool hist <file.dg5>\n"
+      "       dg5tool catalog <directory> <index> [-r]\n"
+      "       dg5tool list <index>\n");
+    return 2;
+  }
+
+  int Diff(const std::filesystem::path& a, const std::filesystem::path& b)
+  {
+    fileManagement::MappedFile first(a);
+    fileManagement::MappedFile second(b);
+    fileManagement::DiffStats stats = fileManagement::diff(first.bytes(), second.bytes());
+
+    if (stats.differingPixels == 0) {
+      std::printf("0 pixels differ\n");
+      return 0;
+    }
+
+    std::printf("%llu pixels differ in %dx%d at (%d, %d)\n",
+      static_cast<unsigned long long>(stats.differingPixels), stats.width, stats.height, stats.x, stats.y);
+    return 1;
+  }
+
+  int Equal(const std::filesystem::path& a, const std::filesystem::path& b)
+  {
+    fileManagement::MappedFile first(a);
+    fileManagement::MappedFile second(b);
+
+    return fileManagement::equal(first.bytes(), second.bytes()) ? 0 : 1;
+  }
+
+  int Histogram(const std::filesystem::path& path)
+  {
+    fileManagement::MappedFile file(path);
+
+    auto counts = fileManagement::histogram(file.bytes());
+    for (size_t i = 0; i < counts.size(); i++) {
+      std::printf("%2zu %llu\n", i, static_cast<unsigned long long>(counts[i]));
+    }
+    return 0;
+  }
+
+  void PrintEntry(const fileManagement::CatalogEntry& entry)
+  {
+    std::printf("%s v%d %dx%d mode %d dithering %d%s%s %llu bytes\n",
+      entry.path.generic_string().c_str(), entry.version, entry.width, entry.height, entry.mode, entry.dithering,
+      entry.indexed ? " indexed" : "", entry.planar ? " planar" : "",
+      static_cast<unsigned long long>(entry.fileSize));
+  }
+
+  int Catalog(const std::filesystem::path& directory, const std::filesystem::path& index, bool recursive)
+  {
+    auto entries = fileManagement::buildCatalog(directory, index, recursive);
+
+    std::printf("%zu files catalogued\n", entries.size());
+    return 0;
+  }
+
+  int List(const std::filesystem::path& index)
+  {
+    for (const auto& entry : fileManagement::readCatalog(index)) {
+      PrintEntry(entry);
+    }
+    return 0;
+  }
+
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    return Usage();
+  }
+
+  try {
+    if (std::strcmp(argv[1], "diff") == 0 && argc == 4) {
+      return Diff(argv[2], argv[3]);
+    }
+    if (std::strcmp(argv[1], "equal") == 0 && argc == 4) {
+      return Equal(argv[2], argv[3]);
+    }
+    if (std::strcmp(argv[1], "hist") == 0 && argc == 3) {
+      return Histogram(argv[2]);
+    }
+    if (std::strcmp(argv[1], "catalog") == 0 && (argc == 4 || (argc == 5 && std::strcmp(argv[4], "-r") == 0))) {
+      return Catalog(argv[2], argv[3], argc == 5);
+    }
+    if (std::strcmp(argv[1], "list") == 0 && argc == 3) {
+      return List(argv[2]);
+    }
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "dg5tool: %s\n", e.what());
+    return 2;
+  }
+
+  return Usage();
+}
@@ -1,152 +1,394 @@
 #include "fileManagement.h"
 
-#include <cmath>
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
 
+#include "DG5Blocks.h"
+#include "DG5Frames.h"
+#include "DG5Stream.h"
+#include "DG5Tiled.h"
+#include "MappedFile.h"
 #include "Palette.h"
+#include "Parallel.h"
 #include "SDL3/SDL_pixels.h"
 #include "SDL3/SDL_stdinc.h"
 
-Uint8 convertRGBAto5b(std::byte &red, std::byte &green, std::byte &blue) {
-    Uint8 R = (static_cast<Uint8>(red) * 3 + 127) / 255;
-    Uint8 G = (static_cast<Uint8>(green) * 3 + 127) / 255;
-    Uint8 B = (static_cast<Uint8>(blue) + 127) / 255;
+using namespace fileManagement::detail;
+
+namespace {
+    // Quantizes a channel to 2 bits the same way as (value * 3 + 127) / 255.
+    constexpr std::array<Uint8, 256> LEVELS_2BIT = [] {
+        std::array<Uint8, 256> levels{};
+        for (int v = 0; v < 256; v++) {
+            levels[v] = static_cast<Uint8>((v * 3 + 127) / 255);
+        }
+        return levels;
+    }();
+}
+
+Uint8 convertRGBAto5b(std::byte red, std::byte green, std::byte blue) {
+    Uint8 R = LEVELS_2BIT[static_cast<Uint8>(red)];
+    Uint8 G = LEVELS_2BIT[static_cast<Uint8>(green)];
+    Uint8 B = static_cast<Uint8>(blue) >> 7;
 
     return (R << 3) | (G << 1) | B;
 }
 
-SDL_Color convert5btoRGBA(Uint8& color5b) {
-    SDL_Color color;
+namespace {
+    // Fills codes[0..count) with the 5-bit codes of row y starting at startX.
+    struct RGBACodes {
+        const ImageView& image;
+
+        void operator()(int y, int startX, int count, Uint8* codes) const {
+            const std::byte* pixel = reinterpret_cast<const std::byte*>(image.Row(y) + startX);
+            for (int i = 0; i < count; i++, pixel += 4) {
+                codes[i] = convertRGBAto5b(pixel[0], pixel[1], pixel[2]);
+            }
+        }
+    };
+
+    // Column strips occupy disjoint height * 5 byte regions of the payload
+    // and disjoint 8-pixel columns of the image, so they are encoded and
+    // decoded independently on the worker pool.
+    template <typename RowCodes>
+    void encodeBlocks(const RowCodes& rowCodes, const BlockRegion& region, const BlockLayout& layout, Uint8* blocks) {
+        Parallel::For(region.columns(), minColumnsPerTask(region.height), [&](int firstCol, int lastCol) {
+            encodeColumns(rowCodes, region, firstCol, lastCol, layout, blocks);
+        });
+    }
+
+    void decodeBlocks(const Uint8* blocks, const BlockRegion& region, const BlockLayout& layout, int planeMask, const Uint32* table, const PixelWindow& out) {
+        Parallel::For(region.columns(), minColumnsPerTask(region.height), [&](int firstCol, int lastCol) {
+            decodeColumns(blocks, region, firstCol, lastCol, layout, planeMask, table, out);
+        });
+    }
 
-    color.r = static_cast<Uint8>(round(((color5b>>3)&3)*255.0/3.0));
-    color.g = static_cast<Uint8>(round(((color5b>>1)&3)*255.0/3.0));
-    color.b = static_cast<Uint8>(round(((color5b>>0)&1)*255.0/1.0));
+    void writeHeader(Uint8* out, int width, int height, int mode, int dithering, size_t payloadSize) {
+        Uint32 payloadSize32 = static_cast<Uint32>(payloadSize);
 
-    return color;
+        out[0] = 'D';
+        out[1] = 'G';
+        std::memcpy(out + 2, &width, 2);
+        std::memcpy(out + 4, &height, 2);
+        out[6] = static_cast<Uint8>(mode);
+        out[7] = static_cast<Uint8>(dithering);
+        std::memcpy(out + 8, &payloadSize32, 4);
+    }
 }
 
-void fileManagement::saveToFile(std::vector<std::byte>& image, std::filesystem::path path, int width, int height, int mode, int dithering) {
-    std::ofstream file(path, std::ios::binary);
-    const int PIXELS_PER_BLOCK = 8;
-    const int BYTES_PER_BLOCK = 5;
-    int columns = (width + PIXELS_PER_BLOCK - 1) / PIXELS_PER_BLOCK;
+fileManagement::detail::Header fileManagement::detail::parseHeader(std::span<const std::byte> data) {
+    Header header;
 
+    if (data.size() < HEADER_SIZE + PALETTE_SIZE
+        || data[0] != std::byte{'D'} || data[1] != std::byte{'G'}) {
+        throw std::invalid_argument("Not a DG5 file");
+    }
 
-    if (!file) {
-        throw std::invalid_argument("Can't open file");
+    Uint16 width = 0;
+    Uint16 height = 0;
+    std::memcpy(&width, data.data() + 2, 2);
+    std::memcpy(&height, data.data() + 4, 2);
+    header.width = width;
+    header.height = height;
+    header.modeByte = static_cast<Uint8>(data[6]);
+    header.dithering = static_cast<Uint8>(data[7]);
+
+    Uint16 version = 0;
+    if (width == 0 && height == 0 && data.size() >= V2_HEADER_SIZE + PALETTE_SIZE) {
+        std::memcpy(&version, data.data() + 12, 2);
     }
 
-    file.write("DG", 2);
-    file.write(reinterpret_cast<const char*>(&width), 2);
-    file.write(reinterpret_cast<const char*>(&height), 2);
-    file.write(reinterpret_cast<const char*>(&mode), 1);
-    file.write(reinterpret_cast<const char*>(&dithering), 1);
-    int temp = columns * height * BYTES_PER_BLOCK;
-    file.write(reinterpret_cast<const char*>(&temp), 4);
+    if (version == V2_VERSION) {
+        Uint16 tileSize = 0;
+        Uint32 width32 = 0;
+        Uint32 height32 = 0;
+        std::memcpy(&tileSize, data.data() + 14, 2);
+        std::memcpy(&width32, data.data() + 16, 4);
+        std::memcpy(&height32, data.data() + V2_HEIGHT_OFFSET, 4);
+
+        int layout = static_cast<Uint8>(data[25]);
+        bool blockAligned = layout != LAYOUT_ROW_STRIPS;
+
+        if (tileSize == 0 || layout > LAYOUT_FRAMES
+            || (blockAligned && tileSize % PIXELS_PER_BLOCK != 0)
+            || width32 > 0x7FFFFFFF || height32 > 0x7FFFFFFF) {
+            throw std::invalid_argument("Corrupt DG5 v2 header");
+        }
 
-    for (auto color: Palette::Generate(image, width, height, mode)) {
-        file.put(static_cast<const char>((color >> 16) & 0xFF));
-        file.put(static_cast<const char>((color >> 8) & 0xFF));
-        file.put(static_cast<const char>(color & 0xF));
+        header.version = V2_VERSION;
+        header.width = static_cast<int>(width32);
+        header.height = static_cast<int>(height32);
+        header.tileSize = tileSize;
+        header.compression = static_cast<Uint8>(data[24]);
+        header.layout = layout;
+        header.paletteOffset = V2_HEADER_SIZE;
     }
 
-    for (int col = 0; col < columns; col++) {
-        int startX = col * PIXELS_PER_BLOCK;
+    return header;
+}
 
-        for (int y = 0; y < height; y++) {
-            Uint8 pixels[8] = {0};
+void fileManagement::detail::writeHeaderV2(Uint8* out, int width, int height, int tileSize, int modeByte, int dithering, int compression, int layout) {
+    Uint16 version = V2_VERSION;
+    Uint16 tileSize16 = static_cast<Uint16>(tileSize);
+    Uint32 width32 = static_cast<Uint32>(width);
+    Uint32 height32 = static_cast<Uint32>(height);
+
+    std::memset(out, 0, V2_HEADER_SIZE);
+    out[0] = 'D';
+    out[1] = 'G';
+    out[6] = static_cast<Uint8>(modeByte);
+    out[7] = static_cast<Uint8>(dithering);
+    std::memcpy(out + 12, &version, 2);
+    std::memcpy(out + 14, &tileSize16, 2);
+    std::memcpy(out + 16, &width32, 4);
+    std::memcpy(out + V2_HEIGHT_OFFSET, &height32, 4);
+    out[24] = static_cast<Uint8>(compression);
+    out[25] = static_cast<Uint8>(layout);
+}
 
-            for (int i = 0; i < PIXELS_PER_BLOCK; i++) {
-                int x = startX + i;
-                if (x < width) {
-                    int pixelsLocation = (y * width + x) * 4;
+std::array<Uint32, 32> fileManagement::detail::Header::decodeTable(std::span<const std::byte> data) const {
+    // Indexed files carry the real palette; older files hold fixed RGB 2-2-1 codes.
+    if (modeByte & FLAG_INDEXED) {
+        return readPalette(reinterpret_cast<const Uint8*>(data.data()) + paletteOffset);
+    }
+    return DECODE_TABLE;
+}
 
-                    pixels[i] = convertRGBAto5b(
-                        image[pixelsLocation],
-                        image[pixelsLocation + 1],
-                        image[pixelsLocation + 2]
-                    );
-                }
-            }
+size_t fileManagement::encodedSize(int width, int height) {
+    return HEADER_SIZE + PALETTE_SIZE
+        + static_cast<size_t>(columnCount(width)) * height * BYTES_PER_BLOCK;
+}
 
-            Uint8 outputBytes[5] = {0};
+void fileManagement::encode(std::vector<std::byte>& image, int width, int height, int mode, int dithering, std::span<std::byte> output) {
+    encode(ImageView::Packed(image, width, height), mode, dithering, output);
+}
 
-            for (int bitPos = 0; bitPos < 5; bitPos++) {
-                Uint8 byteValue = 0;
-                for (int pixelIdx = 0; pixelIdx < 8; pixelIdx++) {
-                    if (pixels[pixelIdx] & (1 << bitPos)) {
-                        byteValue |= (1 << pixelIdx);
-                    }
-                }
-                outputBytes[bitPos] = byteValue;
-            }
+void fileManagement::encode(const ImageView& image, int mode, int dithering, std::span<std::byte> output) {
+    int width = image.width;
+    int height = image.height;
+
+    if (output.size() != encodedSize(width, height)) {
+        throw std::invalid_argument("Output buffer has the wrong size");
+    }
+
+    Uint8* out = reinterpret_cast<Uint8*>(output.data());
+    writeHeader(out, width, height, mode, dithering, output.size() - HEADER_SIZE - PALETTE_SIZE);
+
+    // Entries missing from a short palette (tiny images) stay zeroed so the
+    // block data always starts at a fixed offset.
+    Uint8* palette = out + HEADER_SIZE;
+    std::memset(palette, 0, PALETTE_SIZE);
+    for (auto color: Palette::Generate(image, mode)) {
+        if (palette == out + HEADER_SIZE + PALETTE_SIZE) break;
+        *palette++ = (color >> 16) & 0xFF;
+        *palette++ = (color >> 8) & 0xFF;
+        *palette++ = color & 0xF;
+    }
+
+    BlockRegion region{0, 0, width, height};
+    encodeBlocks(RGBACodes{image}, region, BlockLayout::interleaved(), out + HEADER_SIZE + PALETTE_SIZE);
+}
+
+std::vector<std::byte> fileManagement::encode(std::vector<std::byte>& image, int width, int height, int mode, int dithering) {
+    return encode(ImageView::Packed(image, width, height), mode, dithering);
+}
+
+std::vector<std::byte> fileManagement::encode(const ImageView& image, int mode, int dithering) {
+    std::vector<std::byte> output(encodedSize(image.width, image.height));
+    encode(image, mode, dithering, output);
+    return output;
+}
+
+void fileManagement::encode(std::span<const std::uint8_t> indices, std::span<const std::uint32_t> palette, int width, int height, int mode, int dithering, std::span<std::byte> output, Layout layout) {
+    if (output.size() != encodedSize(width, height)) {
+        throw std::invalid_argument("Output buffer has the wrong size");
+    }
+    if (indices.size() != static_cast<size_t>(width) * height || palette.size() > PALETTE_COLORS) {
+        throw std::invalid_argument("Index image does not match the palette");
+    }
+
+    Uint8* out = reinterpret_cast<Uint8*>(output.data());
+    int flags = FLAG_INDEXED | (layout == Layout::Planar ? FLAG_PLANAR : 0);
+    writeHeader(out, width, height, (mode & MODE_MASK) | flags, dithering, output.size() - HEADER_SIZE - PALETTE_SIZE);
+    writePalette(palette, out + HEADER_SIZE);
+
+    BlockRegion region{0, 0, width, height};
+    BlockLayout blockLayout = layout == Layout::Planar
+        ? BlockLayout::planar(region.blockCount())
+        : BlockLayout::interleaved();
+    encodeBlocks(IndexCodes{indices, width}, region, blockLayout, out + HEADER_SIZE + PALETTE_SIZE);
+}
+
+std::vector<std::byte> fileManagement::encode(std::span<const std::uint8_t> indices, std::span<const std::uint32_t> palette, int width, int height, int mode, int dithering, Layout layout) {
+    std::vector<std::byte> output(encodedSize(width, height));
+    encode(indices, palette, width, height, mode, dithering, output, layout);
+    return output;
+}
+
+fileManagement::DG5ImageData fileManagement::decode(std::span<const std::byte> data, int planes) {
+    Header header = parseHeader(data);
+    if (header.version == V2_VERSION && header.layout == LAYOUT_ROW_STRIPS) {
+        return decodeStrips(data);
+    }
+    if (header.version == V2_VERSION && header.layout == LAYOUT_FRAMES) {
+        return FrameReader(data).frame(0);
+    }
+    if (header.version == V2_VERSION) {
+        return decodeTiled(data);
+    }
 
-            file.write(reinterpret_cast<const char*>(outputBytes), sizeof(Uint8) * BYTES_PER_BLOCK);
+    DG5ImageData image;
+    image.width = header.width;
+    image.height = header.height;
+    image.image.resize(static_cast<size_t>(image.width) * image.height * 4);
+
+    BlockRegion region{0, 0, image.width, image.height};
+    auto blocks = data.subspan(HEADER_SIZE + PALETTE_SIZE);
+    size_t blockCount = region.blockCount();
+    planes = std::clamp(planes, 0, PLANE_COUNT);
+
+    BlockLayout layout = BlockLayout::interleaved();
+    std::vector<std::byte> padded;
+    if (header.planar()) {
+        // Only planes that are fully present are used, the rest read as zero.
+        layout = BlockLayout::planar(blockCount);
+        if (blockCount > 0) {
+            planes = std::min<size_t>(planes, blocks.size() / blockCount);
         }
+    } else if (blocks.size() < blockCount * BYTES_PER_BLOCK) {
+        // A truncated file decodes its missing blocks as zeros.
+        padded.resize(blockCount * BYTES_PER_BLOCK);
+        std::memcpy(padded.data(), blocks.data(), blocks.size());
+        blocks = padded;
     }
+    image.planes = planes;
+
+    std::array<Uint32, 32> table = header.decodeTable(data);
+    PixelWindow out{reinterpret_cast<Uint32*>(image.image.data()), static_cast<size_t>(image.width),
+        0, 0, image.width, image.height};
+    decodeBlocks(reinterpret_cast<const Uint8*>(blocks.data()), region, layout, topPlanesMask(planes), table.data(), out);
+
+    return image;
+}
+
+void fileManagement::saveToFile(std::vector<std::byte>& image, std::filesystem::path path, int width, int height, int mode, int dithering) {
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
+
+    std::vector<std::byte> encoded = encode(image, width, height, mode, dithering);
+    file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
 
     file.close();
 };
 
-fileManagement::DG5ImageData fileManagement::loadFromFile(std::filesystem::path path) {
-    std::ifstream file(path, std::ios::binary);
-    DG5ImageData image;
-    int imageSize;
-    const int PIXELS_PER_BLOCK = 8;
-    const int BYTES_PER_BLOCK = 5;
+void fileManagement::saveToFile(const IndexedImage& image, std::filesystem::path path, int mode, int dithering, Layout layout) {
+    std::ofstream file(path, std::ios::binary);
 
     if (!file) {
         throw std::invalid_argument("Can't open file");
     }
 
-    Uint16 szerokoscObrazka = 0;
-    Uint16 wysokoscObrazka = 0;
-    Uint8 ileBitow = 0;
-    char identyfikator[3] = {0};
+    std::vector<std::byte> encoded = encode(image.indices, image.palette, image.width, image.height, mode, dithering, layout);
+    file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
 
-    file.seekg(2, std::ios::beg);
-    file.read(reinterpret_cast<char*>(&image.width), 2);
-    file.read(reinterpret_cast<char*>(&image.height), 2);
-    file.seekg(102, std::ios::cur);
+    file.close();
+};
 
-    int columns = (image.width + PIXELS_PER_BLOCK - 1) / PIXELS_PER_BLOCK;
-    image.image.resize(image.width * image.height * 4);
+fileManagement::DG5Info fileManagement::probe(std::span<const std::byte> data) {
+    Header header = parseHeader(data);
+    DG5Info info;
 
-    for (int col = 0; col < columns; col++) {
-        int startX = col * PIXELS_PER_BLOCK;
+    info.version = header.version;
+    info.width = header.width;
+    info.height = header.height;
+    info.mode = header.mode();
+    info.dithering = header.dithering;
+    info.indexed = header.modeByte & FLAG_INDEXED;
+    info.planar = header.planar();
+    info.palette = header.decodeTable(data);
 
-        for (int y = 0; y < image.height; y++) {
-            Uint8 inputBytes[5];
-            file.read(reinterpret_cast<char*>(&inputBytes), sizeof(Uint8) * BYTES_PER_BLOCK);
+    return info;
+}
 
-            if (file.eof()) break;
+fileManagement::DG5Info fileManagement::probeFile(std::filesystem::path path) {
+    std::ifstream file(path, std::ios::binary);
 
-            Uint8 pixels[8] = {0};
+    if (!file) {
+        throw std::invalid_argument("Can't open file");
+    }
 
-            for (int bitPos = 0; bitPos < 5; bitPos++) {
-                Uint8 byteValue = inputBytes[bitPos];
-                for (int pixelIdx = 0; pixelIdx < 8; pixelIdx++) {
-                    if (byteValue & (1 << pixelIdx)) {
-                        pixels[pixelIdx] |= (1 << bitPos);
-                    }
-                }
-            }
+    // Large enough for a v2 header; v1 files of tiny images may be shorter.
+    std::array<std::byte, V2_HEADER_SIZE + PALETTE_SIZE> bytes;
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
 
-            for (int i = 0; i < PIXELS_PER_BLOCK; i++) {
-                int x = startX + i;
-                if (x < image.width) {
-                    SDL_Color color = convert5btoRGBA(pixels[i]);
-                    int pixelIndex = (y * image.width + x) * 4;
+    return probe(std::span(bytes).first(static_cast<size_t>(file.gcount())));
+}
 
-                    image.image[pixelIndex] = static_cast<std::byte>(color.r);
-                    image.image[pixelIndex + 1] = static_cast<std::byte>(color.g);
-                    image.image[pixelIndex + 2] = static_cast<std::byte>(color.b);
-                }
-            }
+fileManagement::DG5ImageData fileManagement::loadFromFile(std::filesystem::path path) {
+    MappedFile file(path);
+
+    return decode(file.bytes());
+};
+
+fileManagement::DG5Reader::DG5Reader(const std::filesystem::path& path) : file(path) {
+    Header header = parseHeader(file.bytes());
+    BlockRegion region{0, 0, header.width, header.height};
+
+    tiled = header.version == V2_VERSION && header.layout == LAYOUT_TILES;
+    bool complete = header.version == 1
+        && file.bytes().size() >= HEADER_SIZE + PALETTE_SIZE + region.blockCount() * BYTES_PER_BLOCK;
+    if (!tiled && !complete) {
+        // Also settles the height of a row-strip file that never got one.
+        decoded = decode(file.bytes());
+        header.width = decoded->width;
+        header.height = decoded->height;
+    }
+
+    imageWidth = header.width;
+    imageHeight = header.height;
+}
+
+void fileManagement::DG5Reader::readStrips(int stripRows, const StripCallback& callback) {
+    if (stripRows <= 0) {
+        throw std::invalid_argument("Invalid DG5 strip height");
+    }
+
+    if (decoded) {
+        size_t rowBytes = static_cast<size_t>(imageWidth) * 4;
+        for (int y = 0; y < imageHeight; y += stripRows) {
+            int rows = std::min(stripRows, imageHeight - y);
+            callback(y, rows, std::span<const std::byte>(decoded->image).subspan(y * rowBytes, rows * rowBytes));
         }
+        return;
     }
 
-    file.close();
+    std::span<const std::byte> data = file.bytes();
+    Header header = parseHeader(data);
+    BlockRegion region{0, 0, imageWidth, imageHeight};
+    std::array<Uint32, 32> table = header.decodeTable(data);
+    BlockLayout layout = header.planar() ? BlockLayout::planar(region.blockCount()) : BlockLayout::interleaved();
+    const Uint8* blocks = reinterpret_cast<const Uint8*>(data.data()) + HEADER_SIZE + PALETTE_SIZE;
+    std::vector<std::byte> strip;
+
+    for (int y = 0; y < imageHeight; y += stripRows) {
+        int rows = std::min(stripRows, imageHeight - y);
+
+        if (tiled) {
+            DG5ImageData part = decodeRegion(data, 0, y, imageWidth, rows);
+            callback(y, rows, part.image);
+            continue;
+        }
 
-    return image;
-};
+        strip.resize(static_cast<size_t>(imageWidth) * rows * 4);
+        PixelWindow out{reinterpret_cast<Uint32*>(strip.data()), static_cast<size_t>(imageWidth),
+            0, y, imageWidth, rows};
+        decodeBlocks(blocks, region, layout, topPlanesMask(PLANE_COUNT), table.data(), out);
+        callback(y, rows, strip);
+    }
+}
@@ -1,16 +1,104 @@
 #pragma once
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
 #include <vector>
 
+#include "IndexedImage.h"
+#include "ImageView.h"
+#include "MappedFile.h"
+
 namespace fileManagement {
     struct DG5ImageData {
         std::vector<std::byte> image = {};
         int width = 0;
         int height = 0;
+        // Most significant bit planes that were decoded (5 for a full decode).
+        int planes = 5;
+    };
+
+    // Header fields of a DG5 file. palette holds the colour of every code
+    // (RGBA, R in the low byte): the stored palette for indexed files, the
+    // fixed RGB 2-2-1 colours for older ones.
+    struct DG5Info {
+        int version = 1;
+        int width = 0;
+        int height = 0;
+        int mode = 0;
+        int dithering = 0;
+        bool indexed = false;
+        bool planar = false;
+        std::array<std::uint32_t, 32> palette = {};
     };
 
+    // Order of the block payload. Interleaved keeps the 5 plane bytes of each
+    // block together. Planar stores every bit plane as its own region, most
+    // significant first, so a coarse preview can be decoded from the top
+    // planes before the rest of the file has arrived.
+    enum class Layout {
+        Interleaved,
+        Planar
+    };
+
+    // Exact size of a DG5 file (header, palette and blocks) for the given dimensions.
+    size_t encodedSize(int width, int height);
+
+    // Encodes into a caller-provided buffer of encodedSize(width, height) bytes.
+    void encode(std::vector<std::byte>& image, int width, int height, int mode, int dithering, std::span<std::byte> output);
+    std::vector<std::byte> encode(std::vector<std::byte>& image, int width, int height, int mode, int dithering);
+
+    // Same for any view, e.g. a region of a larger image.
+    void encode(const ImageView& image, int mode, int dithering, std::span<std::byte> output);
+    std::vector<std::byte> encode(const ImageView& image, int mode, int dithering);
+
+    // Packs an already quantized image (one palette index per pixel, at most
+    // 32 colours) without regenerating the palette.
+    void encode(std::span<const std::uint8_t> indices, std::span<const std::uint32_t> palette, int width, int height, int mode, int dithering, std::span<std::byte> output, Layout layout = Layout::Interleaved);
+    std::vector<std::byte> encode(std::span<const std::uint8_t> indices, std::span<const std::uint32_t> palette, int width, int height, int mode, int dithering, Layout layout = Layout::Interleaved);
+
+    // Decodes a DG5 file held in memory. With planes < 5 only that many of
+    // the most significant bit planes are used and the rest read as zero.
+    // For plane-ordered files data may be a prefix of the file; the decode
+    // then uses the planes that are complete and reports them in planes.
+    DG5ImageData decode(std::span<const std::byte> data, int planes = 5);
+
+    // Reads the header and palette without touching the payload.
+    DG5Info probe(std::span<const std::byte> data);
+    // Reads only the header and palette bytes from disk.
+    DG5Info probeFile(std::filesystem::path path);
+
     void saveToFile(std::vector<std::byte>& image, std::filesystem::path path, int width, int height, int mode, int dithering);
+    void saveToFile(const IndexedImage& image, std::filesystem::path path, int mode, int dithering, Layout layout = Layout::Interleaved);
     DG5ImageData loadFromFile(std::filesystem::path path);
+
+
+    // Strip-wise DG5 decoder, the counterpart of BmpReader. Complete v1
+    // files and tiled v2 files are mapped and decoded one strip at a time,
+    // so the whole RGBA image never exists; other files (truncated,
+    // row-strip and multi-frame) are decoded whole when opened.
+    class DG5Reader {
+    public:
+        explicit DG5Reader(const std::filesystem::path& path);
+
+        int width() const { return imageWidth; }
+        int height() const { return imageHeight; }
+
+        // Hands out the image in strips of up to stripRows rows from the top:
+        // callback(firstRow, rowCount, rgba of rowCount rows). The strip
+        // buffer is reused, so consumers must copy what they keep.
+        using StripCallback = std::function<void(int firstRow, int rowCount, std::span<const std::byte> rgba)>;
+        void readStrips(int stripRows, const StripCallback& callback);
+
+    private:
+        MappedFile file;
+        int imageWidth = 0;
+        int imageHeight = 0;
+        bool tiled = false;
+        // The whole image, for files that can't be read by strip.
+        std::optional<DG5ImageData> decoded;
+    };
 }
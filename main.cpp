@@ -5,26 +5,25 @@
 #include <fstream>
 #include <filesystem>
 #include <array>
+#include <cstring>
 #include <span>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "imgui.h"
 #include "imgui_impl_sdl3.h"
 #include "imgui_impl_sdlrenderer3.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#define STBI_ONLY_BMP
-#include <cstring>
-
-#include "stb_image.h"
-#include "stb_image_write.h"
-
 #include "MyImGui.h"
 #include "Palette.h"
 #include "Quantization.h"
 #include "Dithering.h"
 #include "fileManagement.h"
+#include "DG5Tiled.h"
+#include "Bmp.h"
+#include "IndexedImage.h"
+#include "CompactImage.h"
 
 struct AppState
 {
@@ -37,93 +36,240 @@ struct AppState
   int mode = 0;
   int dithering = 0;
   bool enablePreview = 0;
-
-  std::vector<std::byte> originalImage;
-  std::vector<std::byte> processedImage;
+  bool progressiveSave = false;
+  bool tiledSave = false;
+  bool compressedSave = false;
+
+  CompactImage originalImage;
+  IndexedImage processedImage;
+  // Median-cut sort buffers of the open image, reused across reprocesses.
+  Palette::Scratch paletteScratch;
+  std::vector<uint32_t> generatedPalette;
   int imageWidth, imageHeight;
 
   SDL_Texture* texture = nullptr;
-
-  std::vector<uint32_t> palette;
+  SDL_Palette* texturePalette = nullptr;
 
   bool hasPendingOpen = false;
   std::filesystem::path pendingOpenPath;
 
   bool hasPendingSave = false;
   std::filesystem::path pendingSavePath;
+
+  // Shown under the file buttons until the next successful open or save.
+  std::string errorMessage;
 };
 
 static AppState gApp;
 
-static std::vector<std::byte> LoadBMP(
-    const std::filesystem::path& path, int& x, int& y)
+// Rows decoded per strip when opening a BMP.
+static constexpr int kOpenStripRows = 256;
+
+// Writes into result so its index buffer is reused between reprocesses.
+static void ProcessImage(
+    const CompactImage& originalImage, int mode, int dithering,
+    Palette::Scratch& scratch, IndexedImage& result)
 {
-  auto bufferSize = std::filesystem::file_size(path);
-  std::vector<std::byte> buffer(bufferSize);
-  std::ifstream(path, std::ios::binary).read(
-      reinterpret_cast<char*>(buffer.data()), bufferSize);
+  std::vector<uint32_t> palette = Palette::Generate(originalImage, mode, scratch);
+
+  if (dithering == 0) {
+    Quantization::Apply(originalImage, palette, result);
+    return;
+  }
 
-  unsigned char* imageData = stbi_load_from_memory(
-      reinterpret_cast<const unsigned char*>(buffer.data()),
-      static_cast<int>(bufferSize),
-      &x, &y, 0, 4);
+  Dithering::Apply(originalImage, palette, dithering, result);
+}
+
+// Prefers an 8-bit palettized texture so recolouring only uploads the
+// palette; falls back to RGBA when SDL or the renderer can't do that.
+static void CreateTexture(AppState& app)
+{
+#if SDL_VERSION_ATLEAST(3, 4, 0)
+  app.texture = SDL_CreateTexture(
+      app.renderer,
+      SDL_PIXELFORMAT_INDEX8,
+      SDL_TEXTUREACCESS_STREAMING,
+      app.imageWidth,
+      app.imageHeight);
+
+  if (app.texture) {
+    app.texturePalette = SDL_CreatePalette(256);
+    if (app.texturePalette && SDL_SetTexturePalette(app.texture, app.texturePalette)) {
+      return;
+    }
 
-  const size_t byteCount = x * y * 4;
-  std::vector<std::byte> result(byteCount);
-  std::memcpy(result.data(), imageData, byteCount);
+    SDL_DestroyPalette(app.texturePalette);
+    SDL_DestroyTexture(app.texture);
+    app.texturePalette = nullptr;
+  }
+#endif
+
+  app.texture = SDL_CreateTexture(
+      app.renderer,
+      SDL_PIXELFORMAT_RGBA32,
+      SDL_TEXTUREACCESS_STREAMING,
+      app.imageWidth,
+      app.imageHeight);
+}
 
-  stbi_image_free(imageData);
+static void DestroyTexture(AppState& app)
+{
+  if (app.texturePalette) {
+    SDL_DestroyPalette(app.texturePalette);
+    app.texturePalette = nullptr;
+  }
 
-  return result;
+  if (app.texture) {
+    SDL_DestroyTexture(app.texture);
+    app.texture = nullptr;
+  }
 }
 
-static void WriteBMP(
-    std::filesystem::path& path, std::span<std::byte> image, int x, int y)
+static void UploadPalette(AppState& app)
 {
-  void* data = reinterpret_cast<void*>(image.data());
-  stbi_write_bmp(path.string().c_str(), x, y, 4, data);
+  const auto& palette = app.processedImage.palette;
+
+  std::array<SDL_Color, 256> colors = {};
+  for (size_t i = 0; i < palette.size(); ++i) {
+    colors[i] = {
+      static_cast<Uint8>(palette[i]),
+      static_cast<Uint8>(palette[i] >> 8),
+      static_cast<Uint8>(palette[i] >> 16),
+      255
+    };
+  }
+
+  SDL_SetPaletteColors(app.texturePalette, colors.data(), 0, static_cast<int>(palette.size()));
+  SDL_SetTexturePalette(app.texture, app.texturePalette);
 }
 
-static std::vector<std::byte> ProcessImage(
-    std::span<std::byte> originalImage,
-    int imageWidth, int imageHeight, int mode, int dithering)
+// Uploads the processed image. A palettized texture takes the indices as
+// they are, otherwise the image is expanded to RGBA straight into the
+// texture memory.
+static void UploadTexture(AppState& app)
 {
-  gApp.palette = Palette::Generate(
-      originalImage, imageWidth, imageHeight, mode);
+  void* pixels = nullptr;
+  int pitch = 0;
 
-  if (dithering == 0) {
-    return Quantization::Apply(
-        originalImage, imageWidth, imageHeight, gApp.palette);
+  if (!SDL_LockTexture(app.texture, nullptr, &pixels, &pitch)) {
+    return;
+  }
+
+  const IndexedImage& image = app.processedImage;
+  if (app.texturePalette) {
+    for (int i = 0; i < image.height; ++i) {
+      std::memcpy(
+          static_cast<std::byte*>(pixels) + static_cast<size_t>(i) * pitch,
+          image.indices.data() + static_cast<size_t>(i) * image.width,
+          image.width);
+    }
+  } else {
+    Palette::Expand(image, static_cast<std::byte*>(pixels), pitch);
+  }
+
+  SDL_UnlockTexture(app.texture);
+
+  if (app.texturePalette) {
+    UploadPalette(app);
   }
+}
 
-  return Dithering::Apply(
-        originalImage, imageWidth, imageHeight, gApp.palette, dithering);
+// Applies an edited or swapped palette to the existing index image without
+// quantizing again. With a palettized texture only the colours are uploaded.
+void RecolourImage(AppState& app)
+{
+  if (app.processedImage.empty() || !app.texture) {
+    return;
+  }
+
+  if (app.texturePalette) {
+    UploadPalette(app);
+  } else {
+    UploadTexture(app);
+  }
 }
 
 void ReprocessImage(AppState& app)
 {
   if (!app.originalImage.empty()) {
-    app.processedImage = ProcessImage(
-        gApp.originalImage,
-        gApp.imageWidth,
-        gApp.imageHeight,
-        gApp.mode,
-        gApp.dithering);
+    ProcessImage(
+        app.originalImage,
+        app.mode,
+        app.dithering,
+        app.paletteScratch,
+        app.processedImage);
+    app.generatedPalette = app.processedImage.palette;
 
     if (!app.texture) {
-      app.texture = SDL_CreateTexture(
-          app.renderer,
-          SDL_PIXELFORMAT_RGBA32,
-          SDL_TEXTUREACCESS_STATIC,
-          app.imageWidth,
-          app.imageHeight);
+      CreateTexture(app);
+    }
+
+    UploadTexture(app);
+  }
+}
+
+// Leaves the current image untouched when the file can't be opened; a
+// file that turns out broken while its rows are read closes the image.
+static void OpenImage(AppState& app)
+{
+  try {
+    // Both formats are compacted strip by strip while decoding, into the
+    // buffer of the previous image when it is large enough. The palette
+    // scratch of the previous image is dropped before the new one is read.
+    if (app.pendingOpenPath.extension() == ".bmp") {
+      fileManagement::BmpReader reader(app.pendingOpenPath);
+      app.imageWidth = reader.width();
+      app.imageHeight = reader.height();
+      app.paletteScratch.Release();
+      app.originalImage.Reset(reader.width(), reader.height());
+      reader.readStrips(kOpenStripRows, [&](int, int rowCount, std::span<const std::byte> rgba) {
+        app.originalImage.AppendRows(reinterpret_cast<const uint32_t*>(rgba.data()), rowCount);
+      });
+    } else if (app.pendingOpenPath.extension() == ".dg5") {
+      fileManagement::DG5Reader reader(app.pendingOpenPath);
+      app.imageWidth = reader.width();
+      app.imageHeight = reader.height();
+      app.paletteScratch.Release();
+      app.originalImage.Reset(reader.width(), reader.height());
+      reader.readStrips(kOpenStripRows, [&](int, int rowCount, std::span<const std::byte> rgba) {
+        app.originalImage.AppendRows(reinterpret_cast<const uint32_t*>(rgba.data()), rowCount);
+      });
+    }
+  } catch (...) {
+    if (app.originalImage.empty()) {
+      app.originalImage.Reset(0, 0);
+      app.paletteScratch.Release();
+      app.processedImage = {};
+      app.imageWidth = app.imageHeight = 0;
+      DestroyTexture(app);
     }
+    throw;
+  }
 
-    SDL_UpdateTexture(
-        app.texture,
-        nullptr,
-        app.processedImage.data(),
-        app.imageWidth * 4);
+  DestroyTexture(app);
+
+  ReprocessImage(app);
+}
+
+static void SaveImage(AppState& app)
+{
+  if (app.pendingSavePath.extension() == ".bmp") {
+    fileManagement::saveBMP(app.processedImage, app.pendingSavePath);
+  } else if (app.pendingSavePath.extension() == ".dg5" && app.tiledSave) {
+    fileManagement::saveToFileTiled(
+        app.processedImage, app.pendingSavePath,
+        app.mode, app.dithering,
+        fileManagement::DEFAULT_TILE_SIZE,
+        app.compressedSave
+          ? fileManagement::Compression::Lz
+          : fileManagement::Compression::None);
+  } else if (app.pendingSavePath.extension() == ".dg5") {
+    fileManagement::saveToFile(
+        app.processedImage, app.pendingSavePath,
+        app.mode, app.dithering,
+        app.progressiveSave
+          ? fileManagement::Layout::Planar
+          : fileManagement::Layout::Interleaved);
   }
 }
 
@@ -190,33 +336,22 @@ int main(int /*argc*/, char **/*argv*/)
     if (gApp.hasPendingOpen) {
       gApp.hasPendingOpen = false;
 
-      if (gApp.pendingOpenPath.extension() == ".bmp") {
-         gApp.originalImage = LoadBMP(gApp.pendingOpenPath, gApp.imageWidth, gApp.imageHeight);
-      } else if (gApp.pendingOpenPath.extension() == ".dg5") {
-        fileManagement::DG5ImageData imageData = fileManagement::loadFromFile(gApp.pendingOpenPath);
-        gApp.imageWidth = imageData.width;
-        gApp.imageHeight = imageData.height;
-        gApp.originalImage = std::vector<std::byte>(imageData.image.begin(), imageData.image.end());
+      try {
+        OpenImage(gApp);
+        gApp.errorMessage.clear();
+      } catch (const std::exception& e) {
+        gApp.errorMessage = std::string("Nie udało się odczytać pliku: ") + e.what();
       }
-
-      if (gApp.texture) {
-        SDL_DestroyTexture(gApp.texture);
-        gApp.texture = nullptr;
-      }
-
-      ReprocessImage(gApp);
     }
 
     if (gApp.hasPendingSave) {
       gApp.hasPendingSave = false;
 
-      if (gApp.pendingSavePath.extension() == ".bmp") {
-        WriteBMP(gApp.pendingSavePath, gApp.processedImage, gApp.imageWidth, gApp.imageHeight);
-      } else if (gApp.pendingSavePath.extension() == ".dg5") {
-        fileManagement::saveToFile(
-            gApp.processedImage, gApp.pendingSavePath, 
-            gApp.imageWidth, gApp.imageHeight, 
-            gApp.mode, gApp.dithering);
+      try {
+        SaveImage(gApp);
+        gApp.errorMessage.clear();
+      } catch (const std::exception& e) {
+        gApp.errorMessage = std::string("Nie udało się zapisać pliku: ") + e.what();
       }
     }
 
@@ -252,7 +387,20 @@ int main(int /*argc*/, char **/*argv*/)
         ReprocessImage(gApp);
       }
 
-      MyImGui::SettingsPalette(gApp.palette);
+      if (MyImGui::SettingsPalette(gApp.processedImage.palette)) {
+        RecolourImage(gApp);
+      }
+
+      if (ImGui::Button("Przywróć paletę")) {
+        gApp.processedImage.palette = gApp.generatedPalette;
+        RecolourImage(gApp);
+      }
+
+      ImGui::Checkbox("Zapis progresywny (DG5)", &gApp.progressiveSave);
+      ImGui::Checkbox("Zapis w kafelkach (DG5 v2)", &gApp.tiledSave);
+      if (gApp.tiledSave) {
+        ImGui::Checkbox("Kompresja kafelków", &gApp.compressedSave);
+      }
 
       if (ImGui::Button("Zapisz do pliku")) {
         SDL_ShowSaveFileDialog(SaveFileDialogCallback, &gApp, gApp.window, filters, 2, nullptr);
@@ -264,6 +412,10 @@ int main(int /*argc*/, char **/*argv*/)
         SDL_ShowOpenFileDialog(OpenFileDialogCallback, &gApp, gApp.window, filters, 3, nullptr, 0);
       }
 
+      if (!gApp.errorMessage.empty()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", gApp.errorMessage.c_str());
+      }
+
       ImGui::End();
     }
 